@@ -1,82 +1,429 @@
+// system
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <unistd.h>
+#include <unordered_map>
+
 #include "piccolo.h"
 
 static const char* tag = "[core]";
 
-// pointer to the current instance
-static Piccolo* piccolo_ptr;
+// libretro callbacks carry no context, so every call into a core binds the calling thread to the instance that owns
+// it. Callbacks the core makes while that call is in progress dispatch to this instance, which lets different
+// instances run concurrently on different threads
+static thread_local Piccolo* piccolo_ptr = NULL;
+
+// libraries live instances have open, keyed by resolved path. dlopen hands back the already loaded library for a file
+// that is open and cores keep their state in globals, so only the first user opens the file itself and every other
+// instance loads a private copy. What the first one learned about the core is kept so peeks never call into a core
+// another thread may be running
+typedef struct library_entry
+{
+   unsigned users;
+   bool info_valid;
+   core_info_t info;
+} library_entry_t;
 
-unsigned frame = 0;
+static std::mutex library_lock;
+static std::unordered_map<std::string, library_entry_t> libraries;
 
-// set the current core instance
-void Piccolo::set_instance_ptr(Piccolo* piccolo)
+// what a peek reports, everything known before the core is initialized
+static void copy_system_info(core_info_t* dst, const char* path, const core_info_t* src)
 {
-   piccolo_ptr = piccolo;
+   strlcpy(dst->file_name, path, sizeof(dst->file_name));
+   strlcpy(dst->core_name, src->core_name, sizeof(dst->core_name));
+   strlcpy(dst->core_version, src->core_version, sizeof(dst->core_version));
+   strlcpy(dst->extensions, src->extensions, sizeof(dst->extensions));
+   dst->supports_no_game = src->supports_no_game;
+   dst->block_extract = src->block_extract;
+   dst->full_path = src->full_path;
 }
 
-void Piccolo::core_get_variables(void* data)
+static void library_resolve(const char* path, char* resolved, size_t size)
+{
+   char buffer[PATH_MAX_LENGTH];
+
+   strlcpy(resolved, realpath(path, buffer) ? buffer : path, size);
+}
+
+// private copies of libraries in use go to the temp directory, named LIBRARY_COPY_PREFIX<pid>_<n>_<file name>
+#define LIBRARY_COPY_PREFIX "invader_core_"
+
+static const char* library_temp_dir()
+{
+   const char* temp_dir = getenv("TMPDIR");
+
+   if (string_is_empty(temp_dir))
+      temp_dir = getenv("TEMP");
+   if (string_is_empty(temp_dir))
+      temp_dir = "/tmp";
+   return temp_dir;
+}
+
+#ifdef _WIN32
+// a loaded dll can't be removed, so copies a crashed session left behind are swept before the first copy is made.
+// Copies another running session has loaded fail to go and stay
+static void library_sweep(const char* temp_dir)
+{
+   char buf[PATH_MAX_LENGTH];
+   file_list_t list = {};
+
+   get_file_list(temp_dir, &list, ".dll", false);
+   for (unsigned i = 0; i < list.file_count; i++)
+   {
+      const char* name = file_list_get_name(&list, i);
+
+      if (strncmp(name, LIBRARY_COPY_PREFIX, strlen(LIBRARY_COPY_PREFIX)) != 0)
+         continue;
+      snprintf(buf, sizeof(buf), "%s/%s", temp_dir, name);
+      remove(buf);
+   }
+   file_list_free(&list);
+}
+#endif
+
+// binds the current thread to an instance for the lifetime of the scope, restoring the previous binding on exit so
+// calls into one core from within another core's callback stay correct
+class InstanceScope
 {
-   if (piccolo_ptr->option_count == 0)
+private:
+   Piccolo* previous;
+
+public:
+   InstanceScope(Piccolo* piccolo)
+   {
+      previous = piccolo_ptr;
+      piccolo_ptr = piccolo;
+   }
+   ~InstanceScope() { piccolo_ptr = previous; }
+};
+
+Piccolo::Piccolo()
+{
+   library_handle = NULL;
+   library_path[0] = '\0';
+   library_copy[0] = '\0';
+   initialized = false;
+   game_loaded = false;
+   core_options = NULL;
+   core_options_size = 0;
+   option_count = 0;
+   option_index = NULL;
+   option_index_mask = 0;
+   option_dirty = NULL;
+   controller_info = NULL;
+   controller_info_size = 0;
+   input_descriptors = NULL;
+   input_descriptors_size = 0;
+   reset();
+}
+
+Piccolo::~Piccolo()
+{
+   unload_core();
+   free_core_data();
+}
+
+PiccoloPool* PiccoloPool::get()
+{
+   // never destroyed, instances may still come back from static destructors
+   static PiccoloPool* pool = new PiccoloPool();
+
+   return pool;
+}
+
+Piccolo* PiccoloPool::acquire()
+{
+   std::lock_guard<std::mutex> guard(lock);
+   Piccolo* piccolo;
+
+   if (!idle.empty())
+   {
+      piccolo = idle.back();
+      idle.pop_back();
+      recycled++;
+   }
+   else
+   {
+      piccolo = new Piccolo();
+      created++;
+   }
+   active.push_back(piccolo);
+
+   return piccolo;
+}
+
+void PiccoloPool::release(Piccolo* piccolo)
+{
+   if (!piccolo)
       return;
 
-   struct retro_variable* var = (struct retro_variable*)data;
-   var->value = NULL;
+   // unloading the core may take a while, other threads keep using the pool meanwhile
+   piccolo->reset();
 
-   for (int i = 0; i < piccolo_ptr->option_count; i++)
+   std::lock_guard<std::mutex> guard(lock);
+   auto it = std::find(active.begin(), active.end(), piccolo);
+   if (it != active.end())
    {
-      if (!strcmp(var->key, piccolo_ptr->core_options[i].key))
-         var->value = piccolo_ptr->core_options[i].value;
+      *it = active.back();
+      active.pop_back();
    }
+
+   if (idle.size() < PICCOLO_POOL_MAX_IDLE)
+      idle.push_back(piccolo);
+   else
+      delete piccolo;
 }
 
-void Piccolo::core_set_variables(void* data)
+size_t PiccoloPool::get_memory_usage()
 {
-   char buf[PATH_MAX_LENGTH];
-   const char* values;
-   const char* value;
+   std::lock_guard<std::mutex> guard(lock);
+   size_t bytes = 0;
+
+   for (Piccolo* piccolo : active)
+      bytes += piccolo->get_memory_usage();
+   for (Piccolo* piccolo : idle)
+      bytes += piccolo->get_memory_usage();
+   return bytes;
+}
 
-   piccolo_ptr->option_count = 0;
+void Piccolo::free_core_data()
+{
+   free(core_options);
+   free(option_index);
+   free(option_dirty);
+   free(controller_info);
+   free(input_descriptors);
+   core_options = NULL;
+   core_options_size = 0;
+   option_count = 0;
+   option_index = NULL;
+   option_index_mask = 0;
+   option_dirty = NULL;
+   controller_info = NULL;
+   controller_info_size = 0;
+   input_descriptors = NULL;
+   input_descriptors_size = 0;
+}
 
-   struct retro_variable* vars = (struct retro_variable*)data;
+void Piccolo::reset()
+{
+   unload_core();
+   free_core_data();
+
+   options_updated = false;
+   frontend_supports_bitmasks = false;
+   fastforwarding = false;
+   frame = 0;
+
+   memset(&core_info, 0, sizeof(core_info));
+   game_file[0] = '\0';
+   memset(&video_data, 0, sizeof(video_data));
+   audio_callback = NULL;
+   audio_callback_data = NULL;
+   audio_buffer_frames = 0;
+   poll_callback = NULL;
+   poll_callback_data = NULL;
+
+   memset(input_state, 0, sizeof(input_state));
+   memset(input_snapshot, 0, sizeof(input_snapshot));
+   memset(controller_port_device, 0, sizeof(controller_port_device));
+   account();
+}
 
-   // pointer to count and iterate over options
-   struct retro_variable* var = vars;
+void Piccolo::account()
+{
+   size_t bytes = sizeof(*this) + core_options_size;
 
-   // count core options
-   while (var->key)
+   if (option_index)
+      bytes += (option_index_mask + 1) * sizeof(unsigned) + (option_count + 31) / 32 * sizeof(uint32_t);
+   bytes += controller_info_size * sizeof(controller_info_t);
+   bytes += input_descriptors_size * sizeof(input_descriptor_t);
+   // mapped content is backed by the file, only a copy read into memory counts
+   if (!content.IsMapped())
+      bytes += content.GetSize();
+
+   memory_usage.store(bytes, std::memory_order_relaxed);
+}
+
+// fnv-1a, keys are short and hashing them is cheaper than comparing against every option
+static uint32_t option_hash(const char* key)
+{
+   uint32_t hash = 2166136261u;
+
+   for (; *key; key++)
+      hash = (hash ^ (uint8_t)*key) * 16777619u;
+   return hash;
+}
+
+void Piccolo::build_option_index()
+{
+   unsigned size = 16;
+
+   free(option_index);
+   free(option_dirty);
+   option_index = NULL;
+   option_dirty = NULL;
+   option_index_mask = 0;
+
+   if (option_count == 0)
+      return;
+
+   // at most half full so probe sequences stay short
+   while (size < option_count * 2)
+      size *= 2;
+   option_index = (unsigned*)calloc(size, sizeof(unsigned));
+   option_dirty = (uint32_t*)calloc((option_count + 31) / 32, sizeof(uint32_t));
+   option_index_mask = size - 1;
+
+   for (unsigned i = 0; i < option_count; i++)
    {
-      var++;
-      piccolo_ptr->option_count++;
+      unsigned slot = core_options[i].hash & option_index_mask;
+
+      while (option_index[slot])
+         slot = (slot + 1) & option_index_mask;
+      option_index[slot] = i + 1;
    }
-   core_option_t* core_options = piccolo_ptr->core_options;
+}
 
-   logger(LOG_DEBUG, tag, "variables: %u\n", piccolo_ptr->option_count);
+core_option_t* Piccolo::find_option(const char* key)
+{
+   if (!option_index || !key)
+      return NULL;
 
-   for (unsigned i = 0; i < piccolo_ptr->option_count; i++)
+   uint32_t hash = option_hash(key);
+   for (unsigned slot = hash & option_index_mask; option_index[slot]; slot = (slot + 1) & option_index_mask)
    {
-      unsigned j = 0;
-      strlcpy(core_options[i].key, vars[i].key, sizeof(core_options[i].key));
+      core_option_t* option = &core_options[option_index[slot] - 1];
+      if (option->hash == hash && string_is_equal(option->key, key))
+         return option;
+   }
+
+   return NULL;
+}
+
+void Piccolo::set_option_value(size_t index, unsigned value)
+{
+   if (index >= option_count || value >= core_options[index].value_count)
+      return;
+
+   core_options[index].value = value;
+   option_dirty[index / 32] |= 1u << (index % 32);
+   options_updated = true;
+}
 
-      values = strstr(vars[i].value, "; ");
-      value = values;
+void Piccolo::set_options_updated()
+{
+   for (size_t i = 0; i < option_count; i++)
+      option_dirty[i / 32] |= 1u << (i % 32);
+   options_updated = true;
+}
 
-      while (values[j] != '|' && values[j])
+// called every frame by some cores, so it neither allocates nor logs
+void Piccolo::core_get_variables(void* data)
+{
+   struct retro_variable* var = (struct retro_variable*)data;
+   core_option_t* option = piccolo_ptr->find_option(var->key);
+
+   var->value = NULL;
+   if (!option)
+      return;
+
+   size_t index = option - piccolo_ptr->core_options;
+   var->value = core_option_get_value(option);
+   piccolo_ptr->option_dirty[index / 32] &= ~(1u << (index % 32));
+}
+
+void Piccolo::core_set_variables(void* data)
+{
+   struct retro_variable* vars = (struct retro_variable*)data;
+   size_t count = 0;
+   size_t value_count = 0;
+   size_t text_size = 0;
+
+   // size the arena first: every key and declaration is copied once, with its terminator, and the declaration is
+   // split in place into the description and the values
+   for (count = 0; vars[count].key; count++)
+   {
+      const char* declaration = vars[count].value ? vars[count].value : "";
+      const char* separator = strstr(declaration, "; ");
+
+      text_size += strlen(vars[count].key) + 1 + strlen(declaration) + 1;
+      if (separator)
       {
-         value++;
-         j++;
+         value_count++;
+         for (const char* c = separator + 2; *c; c++)
+            value_count += *c == '|';
       }
+   }
 
-      strlcpy(core_options[i].description, vars[i].value, values + 1 - vars[i].value);
-      strlcpy(core_options[i].values, values + 2, sizeof(core_options[i].values));
-      strlcpy(core_options[i].value, values + 2, value - values - 1);
+   free(piccolo_ptr->core_options);
+   piccolo_ptr->core_options_size = count * sizeof(core_option_t) + value_count * sizeof(const char*) + text_size;
+   piccolo_ptr->core_options = (core_option_t*)calloc(1, piccolo_ptr->core_options_size);
+   piccolo_ptr->option_count = count;
+
+   core_option_t* core_options = piccolo_ptr->core_options;
+   const char** values = (const char**)(core_options + count);
+   char* text = (char*)(values + value_count);
+
+   for (size_t i = 0; i < count; i++)
+   {
+      const char* declaration = vars[i].value ? vars[i].value : "";
+      size_t key_size = strlen(vars[i].key) + 1;
+      size_t declaration_size = strlen(declaration) + 1;
+      core_option_t* option = &core_options[i];
+
+      memcpy(text, vars[i].key, key_size);
+      option->key = text;
+      text += key_size;
+
+      memcpy(text, declaration, declaration_size);
+      option->description = text;
+      option->values = values;
+      option->value_count = 0;
+      option->value = 0;
+
+      char* separator = strstr(text, "; ");
+      text += declaration_size;
+      if (separator)
+      {
+         char* token = separator + 2;
+
+         *separator = '\0';
+         for (;;)
+         {
+            char* bar = strchr(token, '|');
+
+            option->values[option->value_count++] = token;
+            if (!bar)
+               break;
+            *bar = '\0';
+            token = bar + 1;
+         }
+         values += option->value_count;
+      }
+      option->hash = option_hash(option->key);
 
       logger(
-         LOG_DEBUG, tag, "key: %s description: %s values: %s default: %s\n", core_options[i].key,
-         core_options[i].description, core_options[i].values, core_options[i].value);
+         LOG_DEBUG, tag, "key: %s description: %s values: %u default: %s\n", option->key, option->description,
+         option->value_count, option->value_count ? option->values[0] : "");
    }
+
+   logger(LOG_DEBUG, tag, "variables: %u, %u bytes\n", (unsigned)count, (unsigned)piccolo_ptr->core_options_size);
+   piccolo_ptr->build_option_index();
+   piccolo_ptr->account();
 }
 
 bool Piccolo::core_set_environment(unsigned cmd, void* data)
 {
+   // cores calling back from threads of their own have no instance bound
+   if (!piccolo_ptr)
+   {
+      logger(LOG_ERROR, tag, "environment callback %d outside of a core call\n", cmd);
+      return false;
+   }
+
    switch (cmd)
    {
       case RETRO_ENVIRONMENT_SET_SUPPORT_NO_GAME:
@@ -95,29 +442,26 @@ bool Piccolo::core_set_environment(unsigned cmd, void* data)
       }
       case RETRO_ENVIRONMENT_GET_VARIABLE:
       {
-         struct retro_variable* var = (struct retro_variable*)data;
          piccolo_ptr->core_get_variables(data);
-         logger(LOG_INFO, tag, "RETRO_ENVIRONMENT_GET_VARIABLE: %s=%s\n", var->key, var->value);
          return true;
          break;
       }
       case RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE:
       {
-         if (piccolo_ptr->core_options)
-            *(bool*)data = piccolo_ptr->options_updated;
-         else
-            *(bool*)data = false;
+         // reported once per batch of changes, the keys that changed stay flagged until the core reads them back
+         *(bool*)data = piccolo_ptr->options_updated;
          if (piccolo_ptr->options_updated)
          {
-            logger(
-               LOG_INFO, tag, "RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE: %s\n",
-               piccolo_ptr->options_updated ? "true" : "false");
+            for (size_t i = 0; i < piccolo_ptr->option_count; i++)
+            {
+               if (piccolo_ptr->get_option_dirty(i))
+                  logger(
+                     LOG_INFO, tag, "RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE: %s=%s\n", piccolo_ptr->core_options[i].key,
+                     core_option_get_value(&piccolo_ptr->core_options[i]));
+            }
             piccolo_ptr->options_updated = false;
-            return true;
          }
-         else
-            return false;
-
+         return true;
          break;
       }
       case RETRO_ENVIRONMENT_SET_PIXEL_FORMAT:
@@ -178,6 +522,7 @@ bool Piccolo::core_set_environment(unsigned cmd, void* data)
             count++;
 
          new_descriptors = (const input_descriptor_t*)data;
+         free(piccolo_ptr->input_descriptors);
          piccolo_ptr->input_descriptors = (input_descriptor_t*)calloc(count, sizeof(input_descriptor_t));
          for (unsigned i = 0; i < count; i++)
          {
@@ -188,6 +533,7 @@ bool Piccolo::core_set_environment(unsigned cmd, void* data)
             piccolo_ptr->input_descriptors[i].description = new_descriptors[i].description;
          }
          piccolo_ptr->input_descriptors_size = count;
+         piccolo_ptr->account();
          return true;
          break;
       }
@@ -198,9 +544,12 @@ bool Piccolo::core_set_environment(unsigned cmd, void* data)
          break;
       }
       case RETRO_ENVIRONMENT_GET_FASTFORWARDING:
-         logger(LOG_DEBUG, tag, "RETRO_ENVIRONMENT_GET_FASTFORWARDING unhandled\n");
-         return false;
+      {
+         if (data)
+            *(bool*)data = piccolo_ptr->fastforwarding;
+         return true;
          break;
+      }
       case RETRO_ENVIRONMENT_SET_CONTROLLER_INFO:
       {
          unsigned count = 0;
@@ -232,6 +581,7 @@ bool Piccolo::core_set_environment(unsigned cmd, void* data)
                   piccolo_ptr->controller_info[i].types[j].desc, i + 1);
             }
          }
+         piccolo_ptr->account();
          return true;
          break;
       }
@@ -273,43 +623,99 @@ bool Piccolo::core_set_environment(unsigned cmd, void* data)
 void Piccolo::core_input_poll()
 {
    if (piccolo_ptr->poll_callback)
-      piccolo_ptr->poll_callback();
+      piccolo_ptr->poll_callback(piccolo_ptr->input_state, MAX_PORTS, piccolo_ptr->poll_callback_data);
    else
       logger(LOG_ERROR, tag, "input poll callback not set\n");
 
-   return;
+   for (unsigned port = 0; port < MAX_PORTS; port++)
+   {
+      input_state_t* state = &piccolo_ptr->input_state[port];
+      input_snapshot_t* snapshot = &piccolo_ptr->input_snapshot[port];
+
+      snapshot->buttons = state->buttons;
+      memcpy(snapshot->analogs, state->analogs, sizeof(snapshot->analogs));
+      for (unsigned i = 0; i < 16; i++)
+      {
+         if (state->analog_buttons[i])
+            snapshot->analog_buttons[i] = state->analog_buttons[i];
+         else
+            snapshot->analog_buttons[i] = (state->buttons >> i) & 1 ? 0x7fff : 0;
+      }
+
+      snapshot->mouse[RETRO_DEVICE_ID_MOUSE_X] = state->mouse_x;
+      snapshot->mouse[RETRO_DEVICE_ID_MOUSE_Y] = state->mouse_y;
+      // movement is only reported once, a core polling twice in a frame sees none the second time
+      state->mouse_x = 0;
+      state->mouse_y = 0;
+      for (unsigned i = RETRO_DEVICE_ID_MOUSE_LEFT; i <= RETRO_DEVICE_ID_MOUSE_BUTTON_5; i++)
+         snapshot->mouse[i] = (state->mouse_buttons >> i) & 1;
+
+      snapshot->pointer[RETRO_DEVICE_ID_POINTER_X] = state->pointer_x;
+      snapshot->pointer[RETRO_DEVICE_ID_POINTER_Y] = state->pointer_y;
+      snapshot->pointer[RETRO_DEVICE_ID_POINTER_PRESSED] = state->pointer_pressed;
+      snapshot->pointer[RETRO_DEVICE_ID_POINTER_COUNT] = state->pointer_pressed;
+
+      memcpy(snapshot->keys, state->keys, sizeof(snapshot->keys));
+   }
 }
 
-// TODO: analogs, keyboards, mice
 int16_t Piccolo::core_input_state(unsigned port, unsigned device, unsigned index, unsigned id)
 {
-   // logger(
-   //   LOG_DEBUG, tag, "frame: %d reading input for port: %d, device: %d, index: %d, id: %d\n", frame, port, device,
-   //   index, id);
-   input_state_t state = piccolo_ptr->input_state[port];
-   int16_t ret;
+   if (port >= MAX_PORTS)
+      return 0;
 
-   // buttons
-   int16_t buttons = state.buttons;
-   if (id == RETRO_DEVICE_ID_JOYPAD_MASK)
-      ret = buttons;
-   else
-      ret = ((state.buttons & (1 << id)) >> id);
+   const input_snapshot_t* snapshot = &piccolo_ptr->input_snapshot[port];
 
-   return ret;
+   switch (device & RETRO_DEVICE_MASK)
+   {
+      case RETRO_DEVICE_JOYPAD:
+         if (id == RETRO_DEVICE_ID_JOYPAD_MASK)
+            return snapshot->buttons;
+         return id < 16 ? (snapshot->buttons >> id) & 1 : 0;
+      case RETRO_DEVICE_ANALOG:
+         if (index == RETRO_DEVICE_INDEX_ANALOG_BUTTON)
+            return id < 16 ? snapshot->analog_buttons[id] : 0;
+         return index < 2 && id < 2 ? snapshot->analogs[index * 2 + id] : 0;
+      case RETRO_DEVICE_KEYBOARD:
+         return id < RETROK_LAST ? (snapshot->keys[id / 32] >> (id % 32)) & 1 : 0;
+      case RETRO_DEVICE_MOUSE:
+         return id <= RETRO_DEVICE_ID_MOUSE_BUTTON_5 ? snapshot->mouse[id] : 0;
+      case RETRO_DEVICE_POINTER:
+         // a single touch, further fingers are never down
+         return index == 0 && id <= RETRO_DEVICE_ID_POINTER_COUNT ? snapshot->pointer[id] : 0;
+   }
+
+   return 0;
+}
+
+// hands the coalesced single samples to the audio callback
+void Piccolo::audio_flush()
+{
+   if (audio_buffer_frames == 0)
+      return;
+
+   if (audio_callback)
+      audio_callback(audio_buffer, audio_buffer_frames, audio_callback_data);
+   audio_buffer_frames = 0;
 }
 
-// TODO: hook this up
 void Piccolo::core_audio_sample(int16_t left, int16_t right)
 {
-   return;
+   piccolo_ptr->audio_buffer[piccolo_ptr->audio_buffer_frames * 2] = left;
+   piccolo_ptr->audio_buffer[piccolo_ptr->audio_buffer_frames * 2 + 1] = right;
+
+   if (++piccolo_ptr->audio_buffer_frames == AUDIO_COALESCE_FRAMES)
+      piccolo_ptr->audio_flush();
 }
 
-// TODO: hook this up
 size_t Piccolo::core_audio_sample_batch(const int16_t* data, size_t frames)
 {
-   // return piccolo_ptr->audio_callback(data, frames);
-   return 0;
+   // keep ordering intact for cores that mix both callbacks
+   piccolo_ptr->audio_flush();
+
+   if (piccolo_ptr->audio_callback)
+      piccolo_ptr->audio_callback(data, frames, piccolo_ptr->audio_callback_data);
+   return frames;
 }
 
 void Piccolo::core_video_refresh(const void* data, unsigned width, unsigned height, size_t pitch)
@@ -321,18 +727,99 @@ void Piccolo::core_video_refresh(const void* data, unsigned width, unsigned heig
    return;
 }
 
+bool Piccolo::load_content(const char* game_file_name)
+{
+   bool ret = false;
+
+   // supports no-game codepath
+   if (!game_file_name)
+   {
+      if (retro_load_game(NULL))
+      {
+         logger(LOG_INFO, tag, "loading without content\n");
+         ret = true;
+      }
+      else
+      {
+         logger(LOG_ERROR, tag, "loading failed\n");
+         ret = false;
+      }
+   }
+   else
+   {
+      if (core_info.full_path)
+      {
+         struct retro_game_info info;
+         info.data = NULL;
+         info.size = 0;
+         info.path = game_file_name;
+         info.meta = NULL;
+         logger(LOG_INFO, tag, "loading file %s\n", info.path);
+         if (!retro_load_game(&info))
+            logger(LOG_ERROR, tag, "core error while opening file %s\n", game_file_name);
+         else
+            ret = true;
+      }
+      else
+      {
+         struct retro_game_info info;
+
+         load_stage = CORE_LOAD_CONTENT;
+         if (!content.Open(game_file_name))
+            logger(LOG_ERROR, tag, "error opening file %s\n", game_file_name);
+         else
+         {
+            info.path = game_file_name;
+            info.data = content.GetData();
+            info.size = content.GetSize();
+            info.meta = NULL;
+            load_stage = CORE_LOAD_GAME;
+            logger(
+               LOG_INFO, tag, "loading file %s from %s\n", info.path, content.IsMapped() ? "a mapping" : "memory");
+            if (!retro_load_game(&info))
+               logger(LOG_ERROR, tag, "core error while opening file %s\n", game_file_name);
+            else
+               ret = true;
+         }
+      }
+   }
+
+   retro_get_system_av_info(&core_info.av_info);
+
+   logger(
+      LOG_DEBUG, tag, "geometry: %ux%d/%ux%d %f\n", core_info.av_info.geometry.base_width,
+      core_info.av_info.geometry.base_height, core_info.av_info.geometry.max_width,
+      core_info.av_info.geometry.max_height, core_info.av_info.geometry.aspect_ratio);
+   logger(LOG_DEBUG, tag, "timing: %ffps %fHz\n", core_info.av_info.timing.fps, core_info.av_info.timing.sample_rate);
+
+   game_loaded = ret;
+   account();
+   return ret;
+}
+
 bool Piccolo::load_game(const char* core_file_name, const char* game_file_name, bool peek)
 {
+   InstanceScope scope(this);
    bool ret = false;
    status = CORE_STATUS_NONE;
+   load_stage = CORE_LOAD_LIBRARY;
 
    if (string_is_empty(core_file_name))
    {
       logger(LOG_ERROR, tag, "filename cannot be null\n");
+      load_stage = CORE_LOAD_DONE;
       return ret;
    }
 
-   option_count = 0;
+   // an instance that already has a core loaded releases it first
+   unload_core();
+   load_stage = CORE_LOAD_LIBRARY;
+   // whatever the previous core declared goes with it
+   free_core_data();
+   frame = 0;
+   audio_buffer_frames = 0;
+   strlcpy(game_file, game_file_name ? game_file_name : "", sizeof(game_file));
+   content.Close();
    core_info.supports_no_game = false;
    core_info.block_extract = false;
    core_info.full_path = false;
@@ -344,14 +831,17 @@ bool Piccolo::load_game(const char* core_file_name, const char* game_file_name,
    void (*set_audio_sample)(retro_audio_sample_t) = NULL;
    void (*set_audio_sample_batch)(retro_audio_sample_batch_t) = NULL;
 
-   library_handle = dylib_load(core_file_name);
-
-   void (*proc)(struct retro_system_info*);
-   proc = (void (*)(struct retro_system_info*))dylib_proc(library_handle, "retro_get_system_info");
+   if (peek && library_peek(core_file_name))
+   {
+      load_stage = CORE_LOAD_DONE;
+      return true;
+   }
 
-   if (!library_handle)
+   if (!library_open(core_file_name))
    {
       logger(LOG_ERROR, tag, "failed to load library: %s\n", core_file_name);
+      library_close();
+      load_stage = CORE_LOAD_DONE;
       return false;
    }
 
@@ -378,10 +868,12 @@ bool Piccolo::load_game(const char* core_file_name, const char* game_file_name,
    logger(LOG_DEBUG, tag, "valid extensions: %s\n", core_info.extensions);
 
    set_environment(core_set_environment);
+   library_publish();
 
    if (peek)
    {
-      dylib_close(library_handle);
+      library_close();
+      load_stage = CORE_LOAD_DONE;
       return true;
    }
 
@@ -406,7 +898,9 @@ bool Piccolo::load_game(const char* core_file_name, const char* game_file_name,
    load_sym(set_audio_sample, retro_set_audio_sample);
    load_sym(set_audio_sample_batch, retro_set_audio_sample_batch);
 
+   load_stage = CORE_LOAD_INIT;
    retro_init();
+   initialized = true;
 
    set_video_refresh(core_video_refresh);
    set_input_poll(core_input_poll);
@@ -415,80 +909,219 @@ bool Piccolo::load_game(const char* core_file_name, const char* game_file_name,
    set_audio_sample_batch(core_audio_sample_batch);
 
    status = CORE_STATUS_LOADED;
+   load_stage = CORE_LOAD_GAME;
 
-   // supports no-game codepath
-   if (!game_file_name)
+   ret = load_content(game_file_name);
+   load_stage = CORE_LOAD_DONE;
+   return ret;
+}
+
+bool Piccolo::peek_info(const char* core_file_name, const core_info_t* info)
+{
+   unload_core();
+   free_core_data();
+   copy_system_info(&core_info, core_file_name, info);
+   load_stage = CORE_LOAD_DONE;
+   return true;
+}
+
+bool Piccolo::swap_game(const char* game_file_name)
+{
+   InstanceScope scope(this);
+
+   if (!initialized)
    {
-      if (retro_load_game(NULL))
-      {
-         logger(LOG_INFO, tag, "loading without content\n");
-         ret = true;
-      }
-      else
-      {
-         logger(LOG_ERROR, tag, "loading failed\n");
-         ret = false;
-      }
+      logger(LOG_ERROR, tag, "no core loaded to swap content on\n");
+      return false;
    }
-   else
+
+   // symbols, options and the core itself stay as they are, only the content is replaced
+   load_stage = CORE_LOAD_GAME;
+   if (game_loaded)
    {
-      if (core_info.full_path)
-      {
-         struct retro_game_info info;
-         info.data = NULL;
-         info.size = 0;
-         info.path = game_file_name;
-         logger(LOG_INFO, tag, "loading file %s\n", info.path);
-         if (!retro_load_game(&info))
-            logger(LOG_ERROR, tag, "core error while opening file %s\n", game_file_name);
-         else
-            ret = true;
-      }
-      else
-      {
-         struct retro_game_info info;
-         FILE* file = fopen(game_file_name, "rb");
-         if (!file)
-            logger(LOG_ERROR, tag, "error opening file %s\n", game_file_name);
-         fseek(file, 0, SEEK_END);
-         info.size = ftell(file);
-         rewind(file);
+      retro_unload_game();
+      game_loaded = false;
+   }
+   content.Close();
+   frame = 0;
+   audio_buffer_frames = 0;
+   memset(&video_data, 0, sizeof(video_data));
+   strlcpy(game_file, game_file_name ? game_file_name : "", sizeof(game_file));
 
-         info.path = game_file_name;
-         info.data = calloc(1, info.size);
+   status = CORE_STATUS_LOADED;
+   bool ret = load_content(game_file_name);
+   // nothing left to run without content
+   if (!ret)
+      status = CORE_STATUS_NONE;
 
-         if (!info.data || !fread((void*)info.data, info.size, 1, file))
-            logger(LOG_ERROR, tag, "error reading file %s\n", game_file_name);
-         if (!retro_load_game(&info))
-            logger(LOG_ERROR, tag, "core error while opening file %s\n", game_file_name);
-         else
-            ret = true;
-      }
+   load_stage = CORE_LOAD_DONE;
+   return ret;
+}
+
+void Piccolo::unload_core()
+{
+   InstanceScope scope(this);
+
+   if (game_loaded)
+   {
+      retro_unload_game();
+      game_loaded = false;
+   }
+   if (initialized)
+   {
+      retro_deinit();
+      initialized = false;
    }
+   library_close();
+   content.Close();
+   status = CORE_STATUS_NONE;
+   load_stage = CORE_LOAD_NONE;
+   account();
+}
 
-   retro_get_system_av_info(&core_info.av_info);
+bool Piccolo::library_open(const char* path)
+{
+   static std::atomic<unsigned> copy_count(0);
+   bool shared;
 
-   logger(
-      LOG_DEBUG, tag, "geometry: %ux%d/%ux%d %f\n", core_info.av_info.geometry.base_width,
-      core_info.av_info.geometry.base_height, core_info.av_info.geometry.max_width,
-      core_info.av_info.geometry.max_height, core_info.av_info.geometry.aspect_ratio);
-   logger(LOG_DEBUG, tag, "timing: %ffps %fHz\n", core_info.av_info.timing.fps, core_info.av_info.timing.sample_rate);
+   library_resolve(path, library_path, sizeof(library_path));
+   {
+      std::lock_guard<std::mutex> lock(library_lock);
+      shared = libraries[library_path].users++ > 0;
+   }
+   if (!shared)
+   {
+      library_handle = dylib_load(path);
+      return library_handle != NULL;
+   }
 
-   return ret;
+   const char* temp_dir = library_temp_dir();
+#ifdef _WIN32
+   static std::once_flag swept;
+   std::call_once(swept, library_sweep, temp_dir);
+#endif
+
+   snprintf(
+      library_copy, sizeof(library_copy), "%s/" LIBRARY_COPY_PREFIX "%u_%u_%s", temp_dir, (unsigned)getpid(),
+      copy_count.fetch_add(1), path_basename(path));
+   if (!file_copy(path, library_copy))
+   {
+      library_copy[0] = '\0';
+      return false;
+   }
+   logger(LOG_DEBUG, tag, "%s is in use, loading a private copy from %s\n", path, library_copy);
+   library_handle = dylib_load(library_copy);
+#ifndef _WIN32
+   // the mapping outlives the file, removing it right away leaves nothing behind if the process dies
+   remove(library_copy);
+   library_copy[0] = '\0';
+#endif
+   return library_handle != NULL;
 }
 
-void Piccolo::core_run(audio_cb_t cb)
+void Piccolo::library_close()
 {
+   if (library_handle)
+   {
+      dylib_close(library_handle);
+      library_handle = NULL;
+   }
+   // a copy that could not be removed while loaded goes once the library is closed
+   if (library_copy[0])
+   {
+      remove(library_copy);
+      library_copy[0] = '\0';
+   }
+   if (library_path[0])
+   {
+      std::lock_guard<std::mutex> lock(library_lock);
+      auto entry = libraries.find(library_path);
+
+      if (entry != libraries.end() && --entry->second.users == 0)
+         libraries.erase(entry);
+      library_path[0] = '\0';
+   }
+}
+
+bool Piccolo::library_peek(const char* path)
+{
+   char resolved[PATH_MAX_LENGTH];
+
+   library_resolve(path, resolved, sizeof(resolved));
+   std::lock_guard<std::mutex> lock(library_lock);
+   auto entry = libraries.find(resolved);
+
+   if (entry == libraries.end() || !entry->second.info_valid)
+      return false;
+
+   copy_system_info(&core_info, path, &entry->second.info);
+   logger(LOG_DEBUG, tag, "peeked %s from the loaded library\n", path);
+   return true;
+}
+
+void Piccolo::library_publish()
+{
+   std::lock_guard<std::mutex> lock(library_lock);
+   auto entry = libraries.find(library_path);
+
+   if (entry == libraries.end() || entry->second.info_valid)
+      return;
+   entry->second.info = core_info;
+   entry->second.info_valid = true;
+}
+
+void Piccolo::core_run()
+{
+   InstanceScope scope(this);
+
    if (status != CORE_STATUS_RUNNING)
       status = CORE_STATUS_RUNNING;
-   piccolo_ptr->retro_run();
+   retro_run();
+   audio_flush();
    frame++;
 }
 
 void Piccolo::core_reset()
 {
+   InstanceScope scope(this);
+
    if (status == CORE_STATUS_RUNNING)
-      piccolo_ptr->retro_reset();
+      retro_reset();
    else
       return;
+}
+
+size_t Piccolo::core_serialize_size()
+{
+   InstanceScope scope(this);
+
+   if (status == CORE_STATUS_NONE)
+      return 0;
+   return retro_serialize_size();
+}
+
+bool Piccolo::core_serialize(void* data, size_t size)
+{
+   InstanceScope scope(this);
+
+   if (status == CORE_STATUS_NONE)
+      return false;
+   return retro_serialize(data, size);
+}
+
+bool Piccolo::core_unserialize(const void* data, size_t size)
+{
+   InstanceScope scope(this);
+
+   if (status == CORE_STATUS_NONE)
+      return false;
+   return retro_unserialize(data, size);
+}
+
+void Piccolo::set_controller_port_device(int port, int device)
+{
+   InstanceScope scope(this);
+
+   controller_port_device[port] = device;
+   retro_set_controller_port_device(port, device);
 }
\ No newline at end of file
@@ -1,11 +1,17 @@
 #ifndef PICCOLO_H_
 #define PICCOLO_H_
 
+// system
+#include <atomic>
+#include <mutex>
+#include <vector>
+
 // libretro common
 extern "C" {
 #include <dynamic/dylib.h>
 }
 #include "libretro.h"
+#include "mapped_file.h"
 
 #include "util.h"
 
@@ -19,6 +25,9 @@ function_t dylib_proc(dylib_t lib, const char* proc);
 #define MAX_PORTS 16
 #define MAX_IDS 12
 
+// instances kept around for reuse once released, any beyond that are freed
+#define PICCOLO_POOL_MAX_IDLE 4
+
 #define load_sym(V, S) \
    do \
    { \
@@ -56,11 +65,11 @@ typedef struct core_frame_buffer
    unsigned pitch;
 } core_frame_buffer_t;
 
-// audio callback
-typedef size_t (*audio_cb_t)(const int16_t*, size_t);
+// audio callback, receives interleaved stereo frames along with the user data registered with it
+typedef size_t (*audio_cb_t)(const int16_t*, size_t, void*);
 
-// input poll callback
-typedef void (*input_poll_t)();
+// single sample audio calls are coalesced into batches of this many frames before reaching the audio callback
+#define AUDIO_COALESCE_FRAMES 512
 
 // core information
 typedef struct core_info
@@ -79,27 +88,71 @@ typedef struct core_info
    struct retro_system_av_info av_info;
 } core_info_t;
 
-// core options
+// core options, every string points into the option arena of the owning instance
 typedef struct core_option
 {
-   char key[100];
-   char description[100];
-   char value[100];
-   char values[PATH_MAX_LENGTH];
+   const char* key;
+   const char* description;
+   // accepted values, split once when the core declares them, the first one is the default
+   const char** values;
+   unsigned value_count;
+   // index of the current value
+   unsigned value;
+   // hash of the key, compared before the key itself on lookups
+   uint32_t hash;
 } core_option_t;
 
+// current value of an option, NULL if the core declared no values for it
+static inline const char* core_option_get_value(const core_option_t* option)
+{
+   return option->value < option->value_count ? option->values[option->value] : NULL;
+}
+
 // controller info
 typedef struct retro_controller_info controller_info_t;
 typedef struct retro_controller_description controller_description_t;
 
-// input state
+// words in a keyboard bitset, one bit per retro_key
+#define INPUT_KEYBOARD_WORDS (RETROK_LAST / 32 + 1)
+
+// input state, as the frontend sets it for a port
 typedef struct
 {
+   // one bit per RETRO_DEVICE_ID_JOYPAD_*
    int16_t buttons;
-   uint16_t analogs[8];
-   uint16_t analog_buttons[16];
+   // indexed by RETRO_DEVICE_INDEX_ANALOG_LEFT / RIGHT * 2 + RETRO_DEVICE_ID_ANALOG_X / Y
+   int16_t analogs[4];
+   // pressure per joypad button, zero for buttons without an analog value
+   int16_t analog_buttons[16];
+   // one bit per retro_key
+   uint32_t keys[INPUT_KEYBOARD_WORDS];
+   // mouse movement since the last poll, one bit per RETRO_DEVICE_ID_MOUSE_* button
+   int16_t mouse_x;
+   int16_t mouse_y;
+   uint16_t mouse_buttons;
+   // pointer position in the [-0x7fff, 0x7fff] range libretro uses
+   int16_t pointer_x;
+   int16_t pointer_y;
+   bool pointer_pressed;
 } input_state_t;
 
+// input as the core sees it during a frame, built from input_state_t on every poll so reads are a single indexed
+// load. Laid out in the order reads are most common and aligned so ports never share a cache line
+typedef struct alignas(64) input_snapshot
+{
+   uint16_t buttons;
+   int16_t analogs[4];
+   // digital buttons read through the analog interface report full pressure
+   int16_t analog_buttons[16];
+   int16_t mouse[RETRO_DEVICE_ID_MOUSE_BUTTON_5 + 1];
+   int16_t pointer[RETRO_DEVICE_ID_POINTER_COUNT + 1];
+   uint32_t keys[INPUT_KEYBOARD_WORDS];
+} input_snapshot_t;
+
+// input poll callback, called when the core polls with the instance's input state for every port. The frontend may
+// refresh it right there, the core sees whatever it holds once the callback returns
+typedef void (*input_poll_t)(input_state_t* state, unsigned ports, void* user);
+
 enum core_status
 {
    CORE_STATUS_NONE = 0,
@@ -107,6 +160,17 @@ enum core_status
    CORE_STATUS_RUNNING
 };
 
+// progress of load_game, readable from other threads while a load is in progress
+enum core_load_stage
+{
+   CORE_LOAD_NONE = 0,
+   CORE_LOAD_LIBRARY,
+   CORE_LOAD_INIT,
+   CORE_LOAD_CONTENT,
+   CORE_LOAD_GAME,
+   CORE_LOAD_DONE
+};
+
 // button descriptors
 typedef struct retro_input_descriptor input_descriptor_t;
 
@@ -116,19 +180,51 @@ class Piccolo
 private:
    // variables
    void* library_handle;
-   unsigned status;
+   // resolved path the library is registered under, and the private copy it was loaded from when another instance
+   // already had the file open
+   char library_path[PATH_MAX_LENGTH];
+   char library_copy[PATH_MAX_LENGTH];
+   // retro_init ran for this instance, and content is loaded on top of it
+   bool initialized;
+   bool game_loaded;
+   // read by the frontend while the core may be running on another thread
+   std::atomic<unsigned> status;
+   std::atomic<unsigned> load_stage;
    bool options_updated;
    bool frontend_supports_bitmasks;
+   // reported to the core through RETRO_ENVIRONMENT_GET_FASTFORWARDING
+   bool fastforwarding;
    size_t option_count;
-
-   core_option_t core_options[1000];
+   unsigned frame;
+
+   // options live in a single block sized to what the core declared: the option array, then the value pointers,
+   // then every string
+   core_option_t* core_options;
+   size_t core_options_size;
+   // open addressed index over the option keys, built when the core declares its options. Slots hold the option
+   // index plus one, zero marks an empty slot
+   unsigned* option_index;
+   unsigned option_index_mask;
+   // one bit per option, set when the frontend changes it and cleared once the core reads it back
+   uint32_t* option_dirty;
    core_info_t core_info;
+   // content loaded with the core, empty when running without content
+   char game_file[PATH_MAX_LENGTH];
+   // content handed to cores that take it from memory, kept until the instance goes away
+   MappedFile content;
    core_frame_buffer_t video_data;
    audio_cb_t audio_callback;
+   void* audio_callback_data;
+
+   int16_t audio_buffer[AUDIO_COALESCE_FRAMES * 2];
+   size_t audio_buffer_frames;
 
    input_poll_t poll_callback;
+   void* poll_callback_data;
 
    input_state_t input_state[MAX_PORTS];
+   // only written when the core polls, read by every core_input_state call
+   input_snapshot_t input_snapshot[MAX_PORTS];
 
    controller_info_t* controller_info;
    size_t controller_info_size;
@@ -138,6 +234,9 @@ private:
 
    int controller_port_device[MAX_PORTS];
 
+   // bytes owned by this instance, updated whenever the core hands over something that is copied
+   std::atomic<size_t> memory_usage;
+
    // libretro variables
    struct retro_system_info system_info;
 
@@ -167,19 +266,45 @@ private:
    static void core_audio_sample(int16_t left, int16_t right);
    static size_t core_audio_sample_batch(const int16_t* data, size_t frames);
    static bool core_set_environment(unsigned cmd, void* data);
+   void audio_flush();
+   void build_option_index();
+   // hand content, or none if game_file_name is NULL, to an initialized core
+   bool load_content(const char* game_file_name);
+   // free everything the core declared through the environment
+   void free_core_data();
+   // open and close the library through the registry of loaded libraries
+   bool library_open(const char* path);
+   void library_close();
+   // fill the core information from a library another instance has loaded, without calling into it
+   bool library_peek(const char* path);
+   void library_publish();
+   void account();
 
 public:
    // constructor
-   Piccolo() { }
-   ~Piccolo() { }
+   Piccolo();
+   // destructor
+   ~Piccolo();
 
    // helper functions
    // load game
    bool load_game(const char* core_file_name, const char* game_file_name, bool peek);
+   // peek without opening the library, with core information gathered earlier
+   bool peek_info(const char* core_file_name, const core_info_t* info);
+   // replace the content on the loaded core, the library stays loaded and initialized
+   bool swap_game(const char* game_file_name);
+   // unload the content, deinitialize the core and close its library
+   void unload_core();
+   // unload the core and return to the state of a new instance, allocations sized by the core are released
+   void reset();
    // core run
-   void core_run(audio_cb_t cb);
+   void core_run();
    // core reset
    void core_reset();
+   // savestates, the size is zero if the core doesn't support serialization
+   size_t core_serialize_size();
+   bool core_serialize(void* data, size_t size);
+   bool core_unserialize(const void* data, size_t size);
 
    // accessors
    // get core information
@@ -188,10 +313,20 @@ public:
    core_option_t* get_options() { return core_options; }
    // get core options count
    size_t get_option_count() { return option_count; }
-   // get video data
-   void set_options_updated() { options_updated = true; }
+   // find an option by key in constant time, NULL if the core didn't declare it
+   core_option_t* find_option(const char* key);
+   // change an option to one of its values, the core is told on its next GET_VARIABLE_UPDATE
+   void set_option_value(size_t index, unsigned value);
+   // whether the option changed since the core last read it
+   bool get_option_dirty(size_t index) { return option_dirty && (option_dirty[index / 32] >> (index % 32)) & 1; }
+   // flag every option as changed
+   void set_options_updated();
+   // get the bytes owned by this instance
+   size_t get_memory_usage() { return memory_usage.load(std::memory_order_relaxed); }
    // get core status
    unsigned get_status() { return status; }
+   // get the stage load_game is at
+   unsigned get_load_stage() { return load_stage; }
    // get video data
    core_frame_buffer_t* get_video_data() { return &video_data; }
    // get input port info
@@ -199,33 +334,91 @@ public:
    // get input port count
    size_t get_controller_port_count() { return controller_info_size; }
    // set device in port
-   void set_controller_port_device(int port, int device)
-   {
-      controller_port_device[port] = device;
-      retro_set_controller_port_device(port, device);
-   }
+   void set_controller_port_device(int port, int device);
+   // get device in port
+   int get_controller_port_device(int port) { return controller_port_device[port]; }
+   // get the content file name, NULL when running without content
+   const char* get_game_file_name() { return string_is_empty(game_file) ? NULL : game_file; }
    // get input descriptors
    input_descriptor_t* get_input_descriptors() { return input_descriptors; }
    // get the count of set input descriptors
    size_t get_input_descriptor_count() { return input_descriptors_size; }
    // set callbacks for stuff that is handled in the frontend
-   void set_callbacks(input_poll_t cb) { poll_callback = cb; }
-   // set input state
-   void set_input_state(unsigned port, input_state_t state)
+   void set_callbacks(input_poll_t cb, void* data)
    {
-      input_state[port].buttons = state.buttons;
-
-      for (unsigned i = 0; i < 8; i++)
-         input_state[port].analogs[i] = state.analogs[i];
+      poll_callback = cb;
+      poll_callback_data = data;
    }
+   // set the callback that receives the core's audio, without one audio is discarded
+   void set_audio_callback(audio_cb_t cb, void* data)
+   {
+      audio_callback = cb;
+      audio_callback_data = data;
+   }
+   // set input state, the core sees it from its next poll on
+   void set_input_state(unsigned port, input_state_t state) { input_state[port] = state; }
    // set support bitmasks
    void set_frontend_supports_bitmasks(bool value) { frontend_supports_bitmasks = value; }
-   // set the current core instance
-   void set_instance_ptr(Piccolo* piccolo);
+   // set fast-forward state, cores may cut their own work while it is set
+   void set_fastforwarding(bool value) { fastforwarding = value; }
+};
+
+// piccolo pool recycles instances instead of allocating one for every peek and load. Released instances are reset
+// and kept for the next acquire, so a session that keeps loading cores holds a flat amount of memory
+class PiccoloPool
+{
+private:
+   std::mutex lock;
+   std::vector<Piccolo*> active;
+   std::vector<Piccolo*> idle;
+   size_t created;
+   size_t recycled;
+
+   PiccoloPool()
+   {
+      created = 0;
+      recycled = 0;
+   }
+
+public:
+   // pool shared by the whole process
+   static PiccoloPool* get();
+
+   // get an instance in its initial state
+   Piccolo* acquire();
+   // hand an instance back, its core is unloaded. NULL is ignored
+   void release(Piccolo* piccolo);
+
+   // accessors
+   // get the bytes owned by every instance, handed out or idle
+   size_t get_memory_usage();
+   // get the instances handed out
+   size_t get_active_count()
+   {
+      std::lock_guard<std::mutex> guard(lock);
+      return active.size();
+   }
+   // get the instances kept for reuse
+   size_t get_idle_count()
+   {
+      std::lock_guard<std::mutex> guard(lock);
+      return idle.size();
+   }
+   // get how many instances were allocated and how many acquires were served by a recycled one
+   size_t get_created_count()
+   {
+      std::lock_guard<std::mutex> guard(lock);
+      return created;
+   }
+   size_t get_recycled_count()
+   {
+      std::lock_guard<std::mutex> guard(lock);
+      return recycled;
+   }
 };
 
-// piccolo controller is a wrapper for piccolo with the single purpose of making sure the correct instance pointer is
-// set in every function call to achieve multi - instancing
+// piccolo wrapper owns the piccolo instance a frontend drives, callbacks are dispatched per instance inside piccolo
+// itself so the wrapper only manages the instance lifetime
 class PiccoloWrapper
 {
 private:
@@ -233,120 +426,91 @@ private:
 
 public:
    // constructor
-   PiccoloWrapper() { }
+   PiccoloWrapper() { piccolo = NULL; }
    // destructor
-   ~PiccoloWrapper() { piccolo->set_instance_ptr(piccolo); }
+   ~PiccoloWrapper() { PiccoloPool::get()->release(piccolo); }
 
    // load core for use
-   bool load_game(const char* core_file_name, const char* game_file_name, bool bitmasks)
+   bool load_game(const char* core_file_name, const char* game_file_name, bool bitmasks, bool peek = false)
    {
-      piccolo->set_instance_ptr(piccolo);
       piccolo->set_frontend_supports_bitmasks(bitmasks);
-      return piccolo->load_game(core_file_name, game_file_name, false);
+      return piccolo->load_game(core_file_name, game_file_name, peek);
+   }
+   // peek with core information gathered earlier
+   bool peek_info(const char* core_file_name, const core_info_t* info)
+   {
+      return piccolo->peek_info(core_file_name, info);
    }
+   // replace the content on the loaded core
+   bool swap_game(const char* game_file_name) { return piccolo->swap_game(game_file_name); }
    // load core to peek for core information
    bool peek_core(const char* core_file_name)
    {
-      piccolo = new Piccolo();
-      piccolo->set_instance_ptr(piccolo);
+      PiccoloPool::get()->release(piccolo);
+      piccolo = PiccoloPool::get()->acquire();
       return piccolo->load_game(core_file_name, NULL, true);
    }
    // core run
-   void core_run(audio_cb_t cb)
-   {
-      piccolo->set_instance_ptr(piccolo);
-      piccolo->core_run(cb);
-   }
+   void core_run() { piccolo->core_run(); }
    // core reset
-   void core_reset()
-   {
-      piccolo->set_instance_ptr(piccolo);
-      piccolo->core_reset();
-   }
+   void core_reset() { piccolo->core_reset(); }
+   // savestates
+   size_t core_serialize_size() { return piccolo->core_serialize_size(); }
+   bool core_serialize(void* data, size_t size) { return piccolo->core_serialize(data, size); }
+   bool core_unserialize(const void* data, size_t size) { return piccolo->core_unserialize(data, size); }
+   // fast-forward state
+   void set_fastforwarding(bool value) { piccolo->set_fastforwarding(value); }
 
    // accessors
    // get core information
-   core_info_t* get_info()
-   {
-      piccolo->set_instance_ptr(piccolo);
-      return piccolo->get_info();
-   }
+   core_info_t* get_info() { return piccolo->get_info(); }
    // get core options array
-   core_option_t* get_options()
-   {
-      piccolo->set_instance_ptr(piccolo);
-      return piccolo->get_options();
-   }
+   core_option_t* get_options() { return piccolo->get_options(); }
    // get core options count
-   size_t get_option_count()
-   {
-      piccolo->set_instance_ptr(piccolo);
-      return piccolo->get_option_count();
-   }
-   // get video data
-   void set_options_updated()
-   {
-      piccolo->set_instance_ptr(piccolo);
-      piccolo->set_options_updated();
-   }
+   size_t get_option_count() { return piccolo->get_option_count(); }
+   // find an option by key
+   core_option_t* find_option(const char* key) { return piccolo->find_option(key); }
+   // change the value of an option
+   void set_option_value(size_t index, unsigned value) { piccolo->set_option_value(index, value); }
+   // flag every option as changed
+   void set_options_updated() { piccolo->set_options_updated(); }
    // get core status
-   unsigned get_status()
-   {
-      piccolo->set_instance_ptr(piccolo);
-      return piccolo->get_status();
-   }
+   unsigned get_status() { return piccolo->get_status(); }
+   // get the stage a load is at
+   unsigned get_load_stage() { return piccolo->get_load_stage(); }
    // get video data
-   core_frame_buffer_t* get_video_data()
-   {
-      piccolo->set_instance_ptr(piccolo);
-      return piccolo->get_video_data();
-   };
+   core_frame_buffer_t* get_video_data() { return piccolo->get_video_data(); }
    // get input port info
-   controller_info_t* get_controller_info()
-   {
-      piccolo->set_instance_ptr(piccolo);
-      return piccolo->get_controller_info();
-   }
+   controller_info_t* get_controller_info() { return piccolo->get_controller_info(); }
    // get input port count
-   size_t get_controller_port_count()
-   {
-      piccolo->set_instance_ptr(piccolo);
-      return piccolo->get_controller_port_count();
-   }
+   size_t get_controller_port_count() { return piccolo->get_controller_port_count(); }
    // set device in port
-   void set_controller_port_device(int port, int device)
-   {
-      piccolo->set_instance_ptr(piccolo);
-      piccolo->set_controller_port_device(port, device);
-   }
+   void set_controller_port_device(int port, int device) { piccolo->set_controller_port_device(port, device); }
+   // get device in port
+   int get_controller_port_device(int port) { return piccolo->get_controller_port_device(port); }
+   // get the content file name
+   const char* get_game_file_name() { return piccolo->get_game_file_name(); }
    // get input descriptors
-   input_descriptor_t* get_input_descriptors()
-   {
-      piccolo->set_instance_ptr(piccolo);
-      return piccolo->get_input_descriptors();
-   }
+   input_descriptor_t* get_input_descriptors() { return piccolo->get_input_descriptors(); }
    // get the count of set input descriptors
-   size_t get_input_descriptor_count()
-   {
-      piccolo->set_instance_ptr(piccolo);
-      return piccolo->get_input_descriptor_count();
-   }
+   size_t get_input_descriptor_count() { return piccolo->get_input_descriptor_count(); }
    // set callbacks for stuff that is handled in the frontend
-   void set_callbacks(input_poll_t cb)
+   void set_callbacks(input_poll_t cb, void* data)
    {
-      piccolo = new Piccolo();
-      piccolo->set_instance_ptr(piccolo);
-      piccolo->set_callbacks(cb);
+      PiccoloPool::get()->release(piccolo);
+      piccolo = PiccoloPool::get()->acquire();
+      piccolo->set_callbacks(cb, data);
    }
+   // set the callback that receives the core's audio
+   void set_audio_callback(audio_cb_t cb, void* data) { piccolo->set_audio_callback(cb, data); }
    // set input state
    void set_input_state(unsigned port, input_state_t state) { piccolo->set_input_state(port, state); }
 
-   // core deinit
+   // core deinit, the instance unloads its core and closes the library on its way out
    void unload_core()
    {
-      piccolo->set_instance_ptr(piccolo);
-      // TODO: hookup actual core unloading
-      delete piccolo;
+      PiccoloPool::get()->release(piccolo);
+      piccolo = NULL;
    }
 };
 
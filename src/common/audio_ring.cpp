@@ -0,0 +1,88 @@
+// system
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio_ring.h"
+#include "util.h"
+
+static const char* tag = "[audio]";
+
+AudioRing::AudioRing(size_t frames)
+{
+   capacity = 1;
+   while (capacity < frames)
+      capacity <<= 1;
+   mask = capacity - 1;
+
+   buffer = (int16_t*)calloc(capacity * 2, sizeof(int16_t));
+   if (!buffer)
+   {
+      logger(LOG_ERROR, tag, "failed to allocate audio ring of %u frames\n", (unsigned)capacity);
+      capacity = 0;
+      mask = 0;
+   }
+
+   write_pos.store(0, std::memory_order_relaxed);
+   read_pos.store(0, std::memory_order_relaxed);
+   overruns.store(0, std::memory_order_relaxed);
+   dropped_frames.store(0, std::memory_order_relaxed);
+   underruns.store(0, std::memory_order_relaxed);
+   missing_frames.store(0, std::memory_order_relaxed);
+}
+
+AudioRing::~AudioRing()
+{
+   free(buffer);
+}
+
+size_t AudioRing::Write(const int16_t* data, size_t frames)
+{
+   size_t write = write_pos.load(std::memory_order_relaxed);
+   size_t read = read_pos.load(std::memory_order_acquire);
+   size_t available = capacity - (write - read);
+
+   if (frames > available)
+   {
+      overruns.fetch_add(1, std::memory_order_relaxed);
+      dropped_frames.fetch_add(frames - available, std::memory_order_relaxed);
+      frames = available;
+   }
+
+   size_t offset = write & mask;
+   size_t first = std::min(frames, capacity - offset);
+
+   memcpy(buffer + offset * 2, data, first * 2 * sizeof(int16_t));
+   memcpy(buffer, data + first * 2, (frames - first) * 2 * sizeof(int16_t));
+
+   write_pos.store(write + frames, std::memory_order_release);
+   return frames;
+}
+
+size_t AudioRing::Read(int16_t* data, size_t frames)
+{
+   size_t read = read_pos.load(std::memory_order_relaxed);
+   size_t write = write_pos.load(std::memory_order_acquire);
+   size_t available = write - read;
+
+   if (frames > available)
+   {
+      underruns.fetch_add(1, std::memory_order_relaxed);
+      missing_frames.fetch_add(frames - available, std::memory_order_relaxed);
+      frames = available;
+   }
+
+   size_t offset = read & mask;
+   size_t first = std::min(frames, capacity - offset);
+
+   memcpy(data, buffer + offset * 2, first * 2 * sizeof(int16_t));
+   memcpy(data + first * 2, buffer, (frames - first) * 2 * sizeof(int16_t));
+
+   read_pos.store(read + frames, std::memory_order_release);
+   return frames;
+}
+
+void AudioRing::Clear()
+{
+   read_pos.store(write_pos.load(std::memory_order_acquire), std::memory_order_release);
+}
@@ -0,0 +1,56 @@
+#ifndef AUDIO_RING_H_
+#define AUDIO_RING_H_
+
+// system
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// audio ring is a single producer / single consumer lock free ring buffer of interleaved stereo int16 frames. The core
+// thread writes, the audio device thread reads, the storage is allocated once at construction so neither side ever
+// locks or allocates
+class AudioRing
+{
+private:
+   int16_t* buffer;
+   size_t capacity;
+   size_t mask;
+
+   // positions grow monotonically and are wrapped on access, each lives on its own cache line so producer and
+   // consumer don't false share
+   alignas(64) std::atomic<size_t> write_pos;
+   alignas(64) std::atomic<size_t> read_pos;
+
+   // statistics, each counter is only written by one side
+   alignas(64) std::atomic<uint64_t> overruns;
+   std::atomic<uint64_t> dropped_frames;
+   alignas(64) std::atomic<uint64_t> underruns;
+   std::atomic<uint64_t> missing_frames;
+
+public:
+   // capacity is rounded up to a power of two frames
+   AudioRing(size_t frames);
+   ~AudioRing();
+
+   // producer side, returns the number of frames stored, anything that doesn't fit is dropped and counted as an
+   // overrun
+   size_t Write(const int16_t* data, size_t frames);
+   // consumer side, returns the number of frames read, a short read is counted as an underrun
+   size_t Read(int16_t* data, size_t frames);
+   // consumer side, discard everything buffered
+   void Clear();
+
+   // frames currently buffered, safe to call from either side
+   size_t GetSize() const
+   {
+      return write_pos.load(std::memory_order_acquire) - read_pos.load(std::memory_order_acquire);
+   }
+   size_t GetCapacity() const { return capacity; }
+
+   uint64_t GetOverruns() const { return overruns.load(std::memory_order_relaxed); }
+   uint64_t GetDroppedFrames() const { return dropped_frames.load(std::memory_order_relaxed); }
+   uint64_t GetUnderruns() const { return underruns.load(std::memory_order_relaxed); }
+   uint64_t GetMissingFrames() const { return missing_frames.load(std::memory_order_relaxed); }
+};
+
+#endif
@@ -0,0 +1,109 @@
+// system
+#include <algorithm>
+#include <thread>
+
+#include "frame_pacer.h"
+
+// bounds of the spin window, in seconds
+#define FRAME_PACER_SPIN_MIN 0.0002
+#define FRAME_PACER_SPIN_MAX 0.004
+// iterations longer than this are stalls, not part of the loop rate
+#define FRAME_PACER_MAX_INTERVAL 0.25
+
+FramePacer::FramePacer()
+{
+   period = 0;
+   Reset();
+}
+
+void FramePacer::SetRate(double fps)
+{
+   double value = fps > 0 ? 1.0 / fps : 0;
+
+   if (value == period)
+      return;
+   period = value;
+   started = false;
+}
+
+void FramePacer::Reset()
+{
+   started = false;
+   spin_window = FRAME_PACER_SPIN_MAX / 2;
+   last_tick = clock::time_point();
+   jitter.store(0, std::memory_order_relaxed);
+   jitter_max.store(0, std::memory_order_relaxed);
+   late.store(0, std::memory_order_relaxed);
+   rate.store(0, std::memory_order_relaxed);
+}
+
+void FramePacer::Tick(clock::time_point now)
+{
+   if (last_tick != clock::time_point())
+   {
+      double interval = std::chrono::duration<double>(now - last_tick).count();
+      double previous = rate.load(std::memory_order_relaxed);
+
+      if (interval > 0 && interval < FRAME_PACER_MAX_INTERVAL)
+         rate.store(previous ? previous + (1.0 / interval - previous) / 64 : 1.0 / interval, std::memory_order_relaxed);
+   }
+   last_tick = now;
+}
+
+void FramePacer::Mark()
+{
+   Tick(clock::now());
+}
+
+void FramePacer::Wait()
+{
+   clock::time_point now = clock::now();
+
+   if (period <= 0)
+   {
+      Tick(now);
+      return;
+   }
+
+   clock::duration step = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(period));
+
+   if (!started)
+   {
+      started = true;
+      deadline = now + step;
+      Tick(now);
+      return;
+   }
+
+   if (now > deadline + step)
+   {
+      late.fetch_add(1, std::memory_order_relaxed);
+      deadline = now + step;
+      Tick(now);
+      return;
+   }
+
+   clock::time_point sleep_target =
+      deadline - std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(spin_window));
+   if (now < sleep_target)
+   {
+      std::this_thread::sleep_until(sleep_target);
+
+      // widen the window right away when the scheduler overslept, narrow it slowly when it didn't
+      double overshoot = std::chrono::duration<double>(clock::now() - sleep_target).count();
+      spin_window = std::max(spin_window * 0.99, overshoot * 1.5);
+      spin_window = std::max(FRAME_PACER_SPIN_MIN, std::min(FRAME_PACER_SPIN_MAX, spin_window));
+   }
+
+   while ((now = clock::now()) < deadline)
+      std::this_thread::yield();
+
+   double error = std::chrono::duration<double, std::micro>(now - deadline).count();
+   double previous = jitter.load(std::memory_order_relaxed);
+   jitter.store(previous + (error - previous) / 16, std::memory_order_relaxed);
+   if (error > jitter_max.load(std::memory_order_relaxed))
+      jitter_max.store(error, std::memory_order_relaxed);
+
+   deadline += step;
+   Tick(now);
+}
@@ -0,0 +1,56 @@
+#ifndef FRAME_PACER_H_
+#define FRAME_PACER_H_
+
+// system
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+// frame pacer holds a loop to a target rate on the monotonic clock. Every wait sleeps for most of the remaining time
+// and spins for the rest, the spin window follows how much the scheduler has been oversleeping so waits land well
+// under a millisecond from the deadline without burning a core. Deadlines advance by exactly one period so the
+// average rate is exact, a loop that falls more than a period behind is resynchronized instead of catching up. Wait
+// and Mark must be called from one thread, the statistics can be read from any thread
+class FramePacer
+{
+private:
+   typedef std::chrono::steady_clock clock;
+
+   double period;
+   bool started;
+   clock::time_point deadline;
+   clock::time_point last_tick;
+   // seconds before the deadline where sleeping stops and spinning starts
+   double spin_window;
+
+   // wake up error in microseconds, smoothed and peak
+   std::atomic<double> jitter;
+   std::atomic<double> jitter_max;
+   // deadlines missed by more than a period
+   std::atomic<uint64_t> late;
+   // measured rate of the loop in Hz
+   std::atomic<double> rate;
+
+   void Tick(clock::time_point now);
+
+public:
+   FramePacer();
+
+   // target rate in Hz, zero disables waiting, a new rate restarts the schedule
+   void SetRate(double fps);
+   double GetTargetRate() const { return period > 0 ? 1.0 / period : 0; }
+   // restart the schedule and the statistics
+   void Reset();
+
+   // block until the next deadline
+   void Wait();
+   // record a loop iteration paced by something else, only updates the measured rate
+   void Mark();
+
+   double GetJitter() const { return jitter.load(std::memory_order_relaxed); }
+   double GetJitterMax() const { return jitter_max.load(std::memory_order_relaxed); }
+   uint64_t GetLate() const { return late.load(std::memory_order_relaxed); }
+   double GetRate() const { return rate.load(std::memory_order_relaxed); }
+};
+
+#endif
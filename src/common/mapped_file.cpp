@@ -0,0 +1,139 @@
+// system
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mapped_file.h"
+#include "util.h"
+
+static const char* tag = "[mapped_file]";
+
+MappedFile::MappedFile()
+{
+   data = NULL;
+   size = 0;
+   mapped = false;
+#ifdef _WIN32
+   file = INVALID_HANDLE_VALUE;
+   mapping = NULL;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+   Close();
+}
+
+// fallback for files that can't be mapped, like empty files or pipes
+static void* read_file(const char* path, size_t* size)
+{
+   FILE* file = fopen(path, "rb");
+   void* buffer = NULL;
+   long length;
+
+   *size = 0;
+   if (!file)
+      return NULL;
+
+   if (fseek(file, 0, SEEK_END) == 0 && (length = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0)
+   {
+      buffer = malloc(length ? length : 1);
+      if (buffer && fread(buffer, 1, length, file) == (size_t)length)
+         *size = length;
+      else
+      {
+         free(buffer);
+         buffer = NULL;
+      }
+   }
+
+   fclose(file);
+   return buffer;
+}
+
+bool MappedFile::Open(const char* path)
+{
+   Close();
+
+#ifdef _WIN32
+   LARGE_INTEGER length;
+
+   file = CreateFileA(
+      path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+   if (file != INVALID_HANDLE_VALUE && GetFileSizeEx(file, &length) && length.QuadPart > 0)
+   {
+      mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+      if (mapping)
+         data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+      if (data)
+      {
+         size = (size_t)length.QuadPart;
+         mapped = true;
+      }
+   }
+#else
+   int fd = open(path, O_RDONLY);
+   struct stat st;
+
+   if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+   {
+      void* view = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+      if (view != MAP_FAILED)
+      {
+         // cores mostly read their content front to back while loading, let the kernel read ahead
+         madvise(view, st.st_size, MADV_SEQUENTIAL);
+         madvise(view, st.st_size, MADV_WILLNEED);
+         data = view;
+         size = st.st_size;
+         mapped = true;
+      }
+   }
+   // the mapping stays valid once the descriptor is closed
+   if (fd >= 0)
+      close(fd);
+#endif
+
+   if (!mapped)
+   {
+      Close();
+      data = read_file(path, &size);
+      if (!data)
+      {
+         logger(LOG_ERROR, tag, "error reading file %s\n", path);
+         return false;
+      }
+   }
+
+   logger(LOG_DEBUG, tag, "%s %s, %zu bytes\n", mapped ? "mapped" : "read", path, size);
+   return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+   if (mapped)
+      UnmapViewOfFile(data);
+   if (mapping)
+      CloseHandle(mapping);
+   if (file != INVALID_HANDLE_VALUE)
+      CloseHandle(file);
+   mapping = NULL;
+   file = INVALID_HANDLE_VALUE;
+#else
+   if (mapped)
+      munmap(data, size);
+#endif
+   if (!mapped)
+      free(data);
+
+   data = NULL;
+   size = 0;
+   mapped = false;
+}
@@ -0,0 +1,35 @@
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+// system
+#include <stddef.h>
+
+// mapped file maps a whole file into memory so content can be handed to a core without reading it into a buffer
+// first. The mapping is copy on write: pages come straight from the page cache and are shared with every other
+// process or instance mapping the same file, a core that patches its content in place only copies the pages it
+// touches. Files that can't be mapped are read into memory instead
+class MappedFile
+{
+private:
+   void* data;
+   size_t size;
+   bool mapped;
+#ifdef _WIN32
+   void* file;
+   void* mapping;
+#endif
+
+public:
+   MappedFile();
+   ~MappedFile();
+
+   bool Open(const char* path);
+   void Close();
+
+   const void* GetData() const { return data; }
+   size_t GetSize() const { return size; }
+   // false when the file was read into memory instead of mapped
+   bool IsMapped() const { return mapped; }
+};
+
+#endif
@@ -0,0 +1,66 @@
+// system
+#include <algorithm>
+
+#include "rate_control.h"
+
+// smoothing factor for the fill level, the device drains in blocks so the raw fill level is a sawtooth that would
+// otherwise show up as ratio jitter
+#define RATE_CONTROL_FILL_SMOOTHING 0.125
+// share of the proportional term accumulated into the drift estimate every frame
+#define RATE_CONTROL_INTEGRAL_GAIN (1.0 / 256)
+
+RateControl::RateControl()
+{
+   Init(0);
+}
+
+void RateControl::Init(size_t target, double max_deviation)
+{
+   this->target = target;
+   this->max_deviation = max_deviation;
+   Reset();
+}
+
+void RateControl::Reset()
+{
+   smoothed_fill = 0;
+   integral = 0;
+   primed = false;
+   adjust.store(1.0, std::memory_order_relaxed);
+   fill.store(0, std::memory_order_relaxed);
+   drift.store(0, std::memory_order_relaxed);
+   saturated.store(0, std::memory_order_relaxed);
+}
+
+double RateControl::Update(size_t current)
+{
+   if (target == 0)
+      return 1.0;
+
+   if (!primed)
+   {
+      smoothed_fill = current;
+      primed = true;
+   }
+   else
+      smoothed_fill += (current - smoothed_fill) * RATE_CONTROL_FILL_SMOOTHING;
+
+   // the proportional term reacts to the distance from the target, an empty buffer asks for the full positive
+   // deviation and a buffer filled to twice the target for the full negative one. The integral term slowly learns
+   // the clock mismatch so the fill level settles on the target instead of an offset proportional to the mismatch
+   double error = std::max(-1.0, std::min(1.0, (target - smoothed_fill) / target)) * max_deviation;
+   integral = std::max(-max_deviation, std::min(max_deviation, integral + error * RATE_CONTROL_INTEGRAL_GAIN));
+
+   double correction = error + integral;
+   double clamped = std::max(-max_deviation, std::min(max_deviation, correction));
+   double value = 1.0 + clamped;
+
+   if (clamped != correction)
+      saturated.fetch_add(1, std::memory_order_relaxed);
+
+   drift.store(integral * 1e6, std::memory_order_relaxed);
+   fill.store(smoothed_fill, std::memory_order_relaxed);
+   adjust.store(value, std::memory_order_relaxed);
+
+   return value;
+}
@@ -0,0 +1,50 @@
+#ifndef RATE_CONTROL_H_
+#define RATE_CONTROL_H_
+
+// system
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// default bound of the ratio adjustment, small enough for the pitch change to be inaudible
+#define RATE_CONTROL_MAX_DEVIATION 0.005
+
+// rate control keeps an audio buffer at a target fill level by nudging the resampling ratio. The fill level is sampled
+// once per frame and smoothed, the adjustment is a proportional plus integral term on the distance from the target,
+// bounded by the maximum deviation. Update runs on the thread producing audio, the statistics can be read from any
+// thread
+class RateControl
+{
+private:
+   double max_deviation;
+   size_t target;
+
+   double smoothed_fill;
+   double integral;
+   bool primed;
+
+   std::atomic<double> adjust;
+   std::atomic<double> fill;
+   // integral term in parts per million, the estimated mismatch between the producer and consumer clocks
+   std::atomic<double> drift;
+   // frames where the adjustment hit the bound, a steadily growing count means the mismatch is larger than the bound
+   std::atomic<uint64_t> saturated;
+
+public:
+   RateControl();
+
+   // target is the fill level to hold in frames, zero disables the adjustment
+   void Init(size_t target, double max_deviation = RATE_CONTROL_MAX_DEVIATION);
+   void Reset();
+
+   // feed the current fill level, returns the factor to scale the output rate by
+   double Update(size_t fill);
+
+   size_t GetTarget() const { return target; }
+   double GetAdjust() const { return adjust.load(std::memory_order_relaxed); }
+   double GetFill() const { return fill.load(std::memory_order_relaxed); }
+   double GetDrift() const { return drift.load(std::memory_order_relaxed); }
+   uint64_t GetSaturated() const { return saturated.load(std::memory_order_relaxed); }
+};
+
+#endif
@@ -0,0 +1,366 @@
+// system
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+   #define RESAMPLER_HAVE_X86
+   #include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+   #define RESAMPLER_HAVE_NEON
+   #include <arm_neon.h>
+#endif
+
+#include "resampler.h"
+#include "util.h"
+
+static const char* tag = "[resampler]";
+
+// the filter passband stops a little short of the lower nyquist frequency to leave room for the transition band
+#define RESAMPLER_SINC_CUTOFF 0.90
+
+static const char* simd_names[] = {"auto", "scalar", "sse2", "avx2", "neon"};
+
+static inline int16_t to_int16(float value)
+{
+   value *= 32768.0f;
+   if (value >= 32767.0f)
+      return 32767;
+   if (value <= -32768.0f)
+      return -32768;
+   return (int16_t)(value + (value >= 0 ? 0.5f : -0.5f));
+}
+
+// sinc dot products, taps are mono and frames are interleaved stereo, out receives the left and right sums
+
+static inline void sinc_dot_scalar(const float* taps, const float* frames, float* out)
+{
+   float left = 0;
+   float right = 0;
+
+   for (unsigned k = 0; k < RESAMPLER_SINC_TAPS; k++)
+   {
+      left += taps[k] * frames[k * 2];
+      right += taps[k] * frames[k * 2 + 1];
+   }
+   out[0] = left;
+   out[1] = right;
+}
+
+#ifdef RESAMPLER_HAVE_X86
+__attribute__((target("sse2"))) static inline void sinc_dot_sse2(const float* taps, const float* frames, float* out)
+{
+   __m128 acc0 = _mm_setzero_ps();
+   __m128 acc1 = _mm_setzero_ps();
+
+   // every tap applies to a left and a right sample, so each group of four taps is duplicated pairwise to line up
+   // with two vectors of interleaved frames
+   for (unsigned k = 0; k < RESAMPLER_SINC_TAPS; k += 4)
+   {
+      __m128 t = _mm_loadu_ps(taps + k);
+      acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_unpacklo_ps(t, t), _mm_loadu_ps(frames + k * 2)));
+      acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_unpackhi_ps(t, t), _mm_loadu_ps(frames + k * 2 + 4)));
+   }
+
+   __m128 acc = _mm_add_ps(acc0, acc1);
+   acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+   _mm_storel_pi((__m64*)out, acc);
+}
+
+__attribute__((target("avx2,fma"))) static inline void sinc_dot_avx2(
+   const float* taps, const float* frames, float* out)
+{
+   const __m256i low = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+   const __m256i high = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+   __m256 acc0 = _mm256_setzero_ps();
+   __m256 acc1 = _mm256_setzero_ps();
+
+   for (unsigned k = 0; k < RESAMPLER_SINC_TAPS; k += 8)
+   {
+      __m256 t = _mm256_loadu_ps(taps + k);
+      acc0 = _mm256_fmadd_ps(_mm256_permutevar8x32_ps(t, low), _mm256_loadu_ps(frames + k * 2), acc0);
+      acc1 = _mm256_fmadd_ps(_mm256_permutevar8x32_ps(t, high), _mm256_loadu_ps(frames + k * 2 + 8), acc1);
+   }
+
+   __m256 acc = _mm256_add_ps(acc0, acc1);
+   __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+   sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+   _mm_storel_pi((__m64*)out, sum);
+}
+#endif
+
+#ifdef RESAMPLER_HAVE_NEON
+static inline void sinc_dot_neon(const float* taps, const float* frames, float* out)
+{
+   float32x4_t acc0 = vdupq_n_f32(0);
+   float32x4_t acc1 = vdupq_n_f32(0);
+
+   for (unsigned k = 0; k < RESAMPLER_SINC_TAPS; k += 4)
+   {
+      float32x4x2_t t = vzipq_f32(vld1q_f32(taps + k), vld1q_f32(taps + k));
+      acc0 = vmlaq_f32(acc0, t.val[0], vld1q_f32(frames + k * 2));
+      acc1 = vmlaq_f32(acc1, t.val[1], vld1q_f32(frames + k * 2 + 4));
+   }
+
+   float32x4_t acc = vaddq_f32(acc0, acc1);
+   vst1_f32(out, vadd_f32(vget_low_f32(acc), vget_high_f32(acc)));
+}
+#endif
+
+// the per frame loop is instantiated once per kernel so the dot product inlines with matching target options
+#define RESAMPLER_SINC_BLOCK(ATTR, NAME, DOT) \
+   ATTR static size_t NAME( \
+      const float* taps, const float* history, size_t history_frames, double* position, double step, int16_t* out) \
+   { \
+      size_t written = 0; \
+      double pos = *position; \
+      float sample[2]; \
+      while ((size_t)pos + RESAMPLER_SINC_TAPS <= history_frames) \
+      { \
+         size_t index = (size_t)pos; \
+         unsigned phase = (unsigned)((pos - index) * RESAMPLER_SINC_PHASES + 0.5); \
+         DOT(taps + phase * RESAMPLER_SINC_TAPS, history + index * 2, sample); \
+         out[written * 2] = to_int16(sample[0]); \
+         out[written * 2 + 1] = to_int16(sample[1]); \
+         written++; \
+         pos += step; \
+      } \
+      *position = pos; \
+      return written; \
+   }
+
+RESAMPLER_SINC_BLOCK(, sinc_block_scalar, sinc_dot_scalar)
+#ifdef RESAMPLER_HAVE_X86
+RESAMPLER_SINC_BLOCK(__attribute__((target("sse2"))), sinc_block_sse2, sinc_dot_sse2)
+RESAMPLER_SINC_BLOCK(__attribute__((target("avx2,fma"))), sinc_block_avx2, sinc_dot_avx2)
+#endif
+#ifdef RESAMPLER_HAVE_NEON
+RESAMPLER_SINC_BLOCK(, sinc_block_neon, sinc_dot_neon)
+#endif
+
+Resampler::Resampler()
+{
+   quality = RESAMPLER_QUALITY_LINEAR;
+   simd = RESAMPLER_SIMD_SCALAR;
+   input_rate = 0;
+   output_rate = 0;
+   step_nominal = 1.0;
+   step = 1.0;
+   position = 0;
+   history = NULL;
+   history_frames = 0;
+   taps = NULL;
+}
+
+Resampler::~Resampler()
+{
+   Deinit();
+}
+
+bool Resampler::IsSupported(unsigned simd)
+{
+   switch (simd)
+   {
+      case RESAMPLER_SIMD_AUTO:
+      case RESAMPLER_SIMD_SCALAR:
+         return true;
+#ifdef RESAMPLER_HAVE_X86
+      case RESAMPLER_SIMD_SSE2:
+         return __builtin_cpu_supports("sse2");
+      case RESAMPLER_SIMD_AVX2:
+         return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+#ifdef RESAMPLER_HAVE_NEON
+      case RESAMPLER_SIMD_NEON:
+         return true;
+#endif
+      default:
+         return false;
+   }
+}
+
+const char* Resampler::GetSimdName(unsigned simd)
+{
+   return simd < RESAMPLER_SIMD_LAST ? simd_names[simd] : "unknown";
+}
+
+bool Resampler::Init(unsigned quality, double input_rate, double output_rate, unsigned simd)
+{
+   Deinit();
+
+   if (quality >= RESAMPLER_QUALITY_LAST || input_rate <= 0 || output_rate <= 0)
+   {
+      logger(LOG_ERROR, tag, "invalid configuration: quality %d %fHz -> %fHz\n", quality, input_rate, output_rate);
+      return false;
+   }
+
+   if (simd == RESAMPLER_SIMD_AUTO)
+   {
+      const unsigned preferred[] = {RESAMPLER_SIMD_AVX2, RESAMPLER_SIMD_NEON, RESAMPLER_SIMD_SSE2};
+
+      simd = RESAMPLER_SIMD_SCALAR;
+      for (int i = 0; i < ARRAY_SIZE(preferred); i++)
+      {
+         if (IsSupported(preferred[i]))
+         {
+            simd = preferred[i];
+            break;
+         }
+      }
+   }
+   else if (!IsSupported(simd))
+   {
+      logger(LOG_WARN, tag, "%s kernel not supported, falling back to scalar\n", GetSimdName(simd));
+      simd = RESAMPLER_SIMD_SCALAR;
+   }
+
+   this->quality = quality;
+   this->simd = simd;
+   this->input_rate = input_rate;
+   this->output_rate = output_rate;
+   step_nominal = input_rate / output_rate;
+   step = step_nominal;
+   position = 0;
+   history_frames = 0;
+
+   history = (float*)calloc((RESAMPLER_CHUNK_FRAMES + RESAMPLER_SINC_TAPS) * 2, sizeof(float));
+   if (quality == RESAMPLER_QUALITY_SINC)
+      taps = (float*)calloc((RESAMPLER_SINC_PHASES + 1) * RESAMPLER_SINC_TAPS, sizeof(float));
+
+   if (!history || (quality == RESAMPLER_QUALITY_SINC && !taps))
+   {
+      logger(LOG_ERROR, tag, "failed to allocate buffers\n");
+      Deinit();
+      return false;
+   }
+
+   if (quality == RESAMPLER_QUALITY_SINC)
+      BuildTaps();
+
+   logger(
+      LOG_INFO, tag, "%s resampler %fHz -> %fHz using %s kernel\n",
+      quality == RESAMPLER_QUALITY_SINC ? "sinc" : "linear", input_rate, output_rate, GetSimdName(simd));
+   return true;
+}
+
+void Resampler::Deinit()
+{
+   free(history);
+   free(taps);
+   history = NULL;
+   taps = NULL;
+   history_frames = 0;
+   position = 0;
+}
+
+// blackman windowed sinc, one row per fractional phase, each row normalized to unity gain
+void Resampler::BuildTaps()
+{
+   const double half = RESAMPLER_SINC_TAPS / 2;
+   const double cutoff = std::min(1.0, output_rate / input_rate) * RESAMPLER_SINC_CUTOFF;
+
+   for (unsigned phase = 0; phase <= RESAMPLER_SINC_PHASES; phase++)
+   {
+      float* row = taps + phase * RESAMPLER_SINC_TAPS;
+      double frac = (double)phase / RESAMPLER_SINC_PHASES;
+      double sum = 0;
+
+      for (unsigned k = 0; k < RESAMPLER_SINC_TAPS; k++)
+      {
+         // distance from the output instant, which sits between taps half - 1 and half
+         double x = k - (half - 1) - frac;
+         double n = x / half;
+         double window = fabs(n) <= 1.0 ? 0.42 + 0.5 * cos(M_PI * n) + 0.08 * cos(2 * M_PI * n) : 0;
+         double sinc = x == 0 ? 1.0 : sin(M_PI * cutoff * x) / (M_PI * cutoff * x);
+
+         row[k] = cutoff * sinc * window;
+         sum += row[k];
+      }
+
+      for (unsigned k = 0; k < RESAMPLER_SINC_TAPS; k++)
+         row[k] /= sum;
+   }
+}
+
+void Resampler::SetAdjust(double value)
+{
+   step = step_nominal / value;
+}
+
+size_t Resampler::GetMaxOutput(size_t frames) const
+{
+   size_t passes = frames / RESAMPLER_CHUNK_FRAMES + 1;
+   return (size_t)((frames + RESAMPLER_SINC_TAPS) / step) + passes + 1;
+}
+
+size_t Resampler::ProcessLinear(int16_t* out)
+{
+   size_t written = 0;
+
+   while ((size_t)position + 1 < history_frames)
+   {
+      size_t index = (size_t)position;
+      float frac = (float)(position - index);
+      const float* a = history + index * 2;
+
+      out[written * 2] = to_int16(a[0] + (a[2] - a[0]) * frac);
+      out[written * 2 + 1] = to_int16(a[1] + (a[3] - a[1]) * frac);
+      written++;
+      position += step;
+   }
+   return written;
+}
+
+size_t Resampler::ProcessSinc(int16_t* out)
+{
+   switch (simd)
+   {
+#ifdef RESAMPLER_HAVE_X86
+      case RESAMPLER_SIMD_SSE2:
+         return sinc_block_sse2(taps, history, history_frames, &position, step, out);
+      case RESAMPLER_SIMD_AVX2:
+         return sinc_block_avx2(taps, history, history_frames, &position, step, out);
+#endif
+#ifdef RESAMPLER_HAVE_NEON
+      case RESAMPLER_SIMD_NEON:
+         return sinc_block_neon(taps, history, history_frames, &position, step, out);
+#endif
+      default:
+         return sinc_block_scalar(taps, history, history_frames, &position, step, out);
+   }
+}
+
+size_t Resampler::Process(const int16_t* in, size_t frames, int16_t* out)
+{
+   size_t written = 0;
+
+   if (!history)
+      return 0;
+
+   while (frames > 0)
+   {
+      size_t chunk = std::min(frames, (size_t)RESAMPLER_CHUNK_FRAMES);
+      float* dst = history + history_frames * 2;
+
+      for (size_t i = 0; i < chunk * 2; i++)
+         dst[i] = in[i] * (1.0f / 32768.0f);
+      history_frames += chunk;
+      in += chunk * 2;
+      frames -= chunk;
+
+      if (quality == RESAMPLER_QUALITY_SINC)
+         written += ProcessSinc(out + written * 2);
+      else
+         written += ProcessLinear(out + written * 2);
+
+      // keep the frames still needed by the next output, everything before the read position is done
+      size_t consumed = std::min((size_t)position, history_frames);
+      memmove(history, history + consumed * 2, (history_frames - consumed) * 2 * sizeof(float));
+      history_frames -= consumed;
+      position -= consumed;
+   }
+
+   return written;
+}
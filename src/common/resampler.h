@@ -0,0 +1,87 @@
+#ifndef RESAMPLER_H_
+#define RESAMPLER_H_
+
+// system
+#include <stddef.h>
+#include <stdint.h>
+
+enum resampler_quality_enum
+{
+   RESAMPLER_QUALITY_LINEAR = 0,
+   RESAMPLER_QUALITY_SINC,
+   RESAMPLER_QUALITY_LAST,
+};
+
+enum resampler_simd_enum
+{
+   RESAMPLER_SIMD_AUTO = 0,
+   RESAMPLER_SIMD_SCALAR,
+   RESAMPLER_SIMD_SSE2,
+   RESAMPLER_SIMD_AVX2,
+   RESAMPLER_SIMD_NEON,
+   RESAMPLER_SIMD_LAST,
+};
+
+// windowed sinc filter length in input frames and number of precomputed fractional phases
+#define RESAMPLER_SINC_TAPS 32
+#define RESAMPLER_SINC_PHASES 256
+
+// input frames converted per pass, larger inputs are processed in several passes
+#define RESAMPLER_CHUNK_FRAMES 1024
+
+// resampler converts interleaved stereo int16 audio from the core rate to the device rate. Input is converted to
+// float into a short history buffer, every output frame is then either linearly interpolated or filtered with a
+// polyphase windowed sinc. The sinc dot product has scalar, SSE2, AVX2 and NEON kernels picked once at init
+class Resampler
+{
+private:
+   unsigned quality;
+   unsigned simd;
+
+   double input_rate;
+   double output_rate;
+   // input frames advanced per output frame, nominal and after the dynamic adjustment
+   double step_nominal;
+   double step;
+   // read position in the history buffer, in input frames
+   double position;
+
+   // interleaved stereo float history, the unconsumed tail of the previous pass is kept at the front
+   float* history;
+   size_t history_frames;
+
+   // (RESAMPLER_SINC_PHASES + 1) rows of RESAMPLER_SINC_TAPS coefficients
+   float* taps;
+
+   size_t ProcessLinear(int16_t* out);
+   size_t ProcessSinc(int16_t* out);
+   void BuildTaps();
+
+public:
+   Resampler();
+   ~Resampler();
+
+   // allocate buffers and precompute filters, returns false if the rates are invalid or allocation failed
+   bool Init(unsigned quality, double input_rate, double output_rate, unsigned simd = RESAMPLER_SIMD_AUTO);
+   void Deinit();
+   bool IsReady() const { return history != NULL; }
+
+   // scale the ratio by a small factor around 1.0 without rebuilding filters, used for dynamic rate control
+   void SetAdjust(double value);
+
+   // resample frames from in into out and return the number of frames written. All input is consumed, out must
+   // hold at least GetMaxOutput(frames) frames
+   size_t Process(const int16_t* in, size_t frames, int16_t* out);
+   size_t GetMaxOutput(size_t frames) const;
+
+   unsigned GetQuality() const { return quality; }
+   unsigned GetSimd() const { return simd; }
+   double GetInputRate() const { return input_rate; }
+   double GetOutputRate() const { return output_rate; }
+
+   // whether a kernel can run on this machine
+   static bool IsSupported(unsigned simd);
+   static const char* GetSimdName(unsigned simd);
+};
+
+#endif
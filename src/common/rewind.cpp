@@ -0,0 +1,260 @@
+// system
+#include <stdlib.h>
+#include <string.h>
+
+#include "rewind.h"
+#include "util.h"
+
+static const char* tag = "[rewind]";
+
+// every token of an encoded delta is a pair of 32 bit word counts, unchanged words to skip followed by changed words
+// stored verbatim as the XOR of both states
+#define REWIND_TOKEN_SIZE 8
+
+static inline uint64_t load_word(const uint8_t* state, size_t size, size_t index)
+{
+   uint64_t word = 0;
+   size_t offset = index * 8;
+
+   if (offset + 8 <= size)
+      memcpy(&word, state + offset, 8);
+   else
+      memcpy(&word, state + offset, size - offset);
+   return word;
+}
+
+RewindBuffer::RewindBuffer()
+{
+   state_size = 0;
+   state_words = 0;
+   current = NULL;
+   has_current = false;
+   staging = NULL;
+   ring = NULL;
+   capacity = 0;
+   head = 0;
+   entries = NULL;
+   first = 0;
+
+   count.store(0, std::memory_order_relaxed);
+   used.store(0, std::memory_order_relaxed);
+   raw_bytes.store(0, std::memory_order_relaxed);
+   stored_bytes.store(0, std::memory_order_relaxed);
+}
+
+RewindBuffer::~RewindBuffer()
+{
+   Deinit();
+}
+
+bool RewindBuffer::Init(size_t state_size, size_t capacity)
+{
+   Deinit();
+
+   if (state_size == 0 || capacity == 0)
+      return false;
+
+   this->state_size = state_size;
+   this->capacity = capacity;
+   state_words = (state_size + 7) / 8;
+
+   current = (uint64_t*)calloc(state_words, sizeof(uint64_t));
+   // worst case is alternating changed and unchanged words, one token for every two words
+   staging = (uint8_t*)malloc(state_words * 8 + (state_words / 2 + 1) * REWIND_TOKEN_SIZE);
+   ring = (uint8_t*)malloc(capacity);
+   entries = (rewind_entry_t*)calloc(REWIND_MAX_ENTRIES, sizeof(rewind_entry_t));
+
+   if (!current || !staging || !ring || !entries)
+   {
+      logger(LOG_ERROR, tag, "failed to allocate %u bytes of rewind history\n", (unsigned)capacity);
+      Deinit();
+      return false;
+   }
+
+   Clear();
+   logger(
+      LOG_INFO, tag, "rewind buffer initialized: state size %u bytes capacity %u bytes\n", (unsigned)state_size,
+      (unsigned)capacity);
+   return true;
+}
+
+void RewindBuffer::Deinit()
+{
+   free(current);
+   free(staging);
+   free(ring);
+   free(entries);
+   current = NULL;
+   staging = NULL;
+   ring = NULL;
+   entries = NULL;
+   state_size = 0;
+   state_words = 0;
+   capacity = 0;
+   has_current = false;
+   head = 0;
+   first = 0;
+   count.store(0, std::memory_order_relaxed);
+   used.store(0, std::memory_order_relaxed);
+}
+
+void RewindBuffer::Clear()
+{
+   has_current = false;
+   head = 0;
+   first = 0;
+   count.store(0, std::memory_order_relaxed);
+   used.store(0, std::memory_order_relaxed);
+   raw_bytes.store(0, std::memory_order_relaxed);
+   stored_bytes.store(0, std::memory_order_relaxed);
+}
+
+size_t RewindBuffer::Encode(const uint8_t* state)
+{
+   uint8_t* out = staging;
+   size_t i = 0;
+
+   while (i < state_words)
+   {
+      size_t start = i;
+      while (i < state_words && load_word(state, state_size, i) == current[i])
+         i++;
+
+      uint8_t* token = out;
+      uint32_t skip = i - start;
+      size_t literal = i;
+
+      out += REWIND_TOKEN_SIZE;
+      while (i < state_words)
+      {
+         uint64_t word = load_word(state, state_size, i) ^ current[i];
+         if (!word)
+            break;
+         memcpy(out, &word, 8);
+         out += 8;
+         i++;
+      }
+
+      uint32_t copy = i - literal;
+      // a trailing run of unchanged words needs no token
+      if (!copy)
+      {
+         out = token;
+         break;
+      }
+      memcpy(token, &skip, 4);
+      memcpy(token + 4, &copy, 4);
+   }
+
+   return out - staging;
+}
+
+void RewindBuffer::Decode(const uint8_t* data, size_t size)
+{
+   const uint8_t* end = data + size;
+   size_t i = 0;
+
+   while (data < end)
+   {
+      uint32_t skip;
+      uint32_t copy;
+
+      memcpy(&skip, data, 4);
+      memcpy(&copy, data + 4, 4);
+      data += REWIND_TOKEN_SIZE;
+      i += skip;
+
+      for (uint32_t k = 0; k < copy; k++)
+      {
+         uint64_t word;
+         memcpy(&word, data, 8);
+         current[i++] ^= word;
+         data += 8;
+      }
+   }
+}
+
+void RewindBuffer::Evict()
+{
+   used.fetch_sub(entries[first].size, std::memory_order_relaxed);
+   first = (first + 1) % REWIND_MAX_ENTRIES;
+   count.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void RewindBuffer::Push(const void* data)
+{
+   const uint8_t* state = (const uint8_t*)data;
+
+   if (!ring)
+      return;
+
+   if (has_current)
+   {
+      size_t size = Encode(state);
+      size_t offset = head;
+
+      // a delta larger than the whole ring can't be stored, the history restarts from this state
+      if (size > capacity)
+      {
+         logger(LOG_WARN, tag, "delta of %u bytes exceeds the rewind capacity\n", (unsigned)size);
+         Clear();
+      }
+      else
+      {
+         // deltas are stored contiguously, the space left at the end is skipped and whatever lives there is the
+         // oldest part of the history
+         if (offset + size > capacity)
+         {
+            while (count.load(std::memory_order_relaxed) && entries[first].offset >= head)
+               Evict();
+            offset = 0;
+         }
+
+         // the oldest delta is always the next one in the way of the write position
+         while (count.load(std::memory_order_relaxed))
+         {
+            rewind_entry_t* oldest = &entries[first];
+            bool overlaps = oldest->offset < offset + size && offset < oldest->offset + oldest->size;
+
+            if (!overlaps && count.load(std::memory_order_relaxed) < REWIND_MAX_ENTRIES)
+               break;
+            Evict();
+         }
+
+         rewind_entry_t* entry = &entries[(first + count.load(std::memory_order_relaxed)) % REWIND_MAX_ENTRIES];
+         entry->offset = offset;
+         entry->size = size;
+         memcpy(ring + offset, staging, size);
+         head = offset + size;
+
+         count.fetch_add(1, std::memory_order_relaxed);
+         used.fetch_add(size, std::memory_order_relaxed);
+         raw_bytes.fetch_add(state_size, std::memory_order_relaxed);
+         stored_bytes.fetch_add(size, std::memory_order_relaxed);
+      }
+   }
+
+   memcpy(current, state, state_size);
+   has_current = true;
+}
+
+bool RewindBuffer::Pop(void* state)
+{
+   if (!ring || !has_current)
+      return false;
+
+   size_t available = count.load(std::memory_order_relaxed);
+   if (available)
+   {
+      rewind_entry_t* newest = &entries[(first + available - 1) % REWIND_MAX_ENTRIES];
+
+      Decode(ring + newest->offset, newest->size);
+      // the newest delta is always the last one written, its space is reused by the next push
+      head = newest->offset;
+      used.fetch_sub(newest->size, std::memory_order_relaxed);
+      count.fetch_sub(1, std::memory_order_relaxed);
+   }
+
+   memcpy(state, current, state_size);
+   return available > 0;
+}
@@ -0,0 +1,79 @@
+#ifndef REWIND_H_
+#define REWIND_H_
+
+// system
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// upper bound on stored snapshots regardless of how well they compress
+#define REWIND_MAX_ENTRIES 65536
+
+typedef struct rewind_entry
+{
+   size_t offset;
+   size_t size;
+} rewind_entry_t;
+
+// rewind buffer keeps a bounded history of savestates. Only the newest state is kept in full, every push stores the
+// previous state as a reverse delta: the XOR of both states with runs of unchanged words squeezed out. Stepping back
+// applies the newest delta to the current state in place, the oldest deltas are evicted once the memory cap is hit.
+// All calls must come from the thread running the core, the statistics can be read from any thread
+class RewindBuffer
+{
+private:
+   size_t state_size;
+   size_t state_words;
+   // newest state, padded to a whole number of words
+   uint64_t* current;
+   bool has_current;
+   // encoded delta of the push in progress, sized for the worst case
+   uint8_t* staging;
+
+   // variable sized deltas are stored back to back in a byte ring and indexed by a ring of entries
+   uint8_t* ring;
+   size_t capacity;
+   size_t head;
+   rewind_entry_t* entries;
+   size_t first;
+
+   std::atomic<size_t> count;
+   std::atomic<size_t> used;
+   std::atomic<uint64_t> raw_bytes;
+   std::atomic<uint64_t> stored_bytes;
+
+   size_t Encode(const uint8_t* state);
+   void Decode(const uint8_t* data, size_t size);
+   void Evict();
+
+public:
+   RewindBuffer();
+   ~RewindBuffer();
+
+   // state size and capacity in bytes, capacity bounds the delta storage only
+   bool Init(size_t state_size, size_t capacity);
+   void Deinit();
+   void Clear();
+   bool IsReady() const { return ring != NULL; }
+   // a snapshot was pushed since the last Init or Clear, Pop has something to restore
+   bool HasState() const { return ring != NULL && has_current; }
+
+   // store a new state of state_size bytes
+   void Push(const void* state);
+   // step back one snapshot and copy it to state, returns false once the history is exhausted, state then holds the
+   // oldest snapshot available. Without any snapshot it returns false and leaves state untouched, see HasState
+   bool Pop(void* state);
+
+   size_t GetStateSize() const { return state_size; }
+   size_t GetCapacity() const { return capacity; }
+   size_t GetCount() const { return count.load(std::memory_order_relaxed); }
+   size_t GetUsed() const { return used.load(std::memory_order_relaxed); }
+   // uncompressed over stored size of every delta pushed so far
+   double GetCompressionRatio() const
+   {
+      uint64_t stored = stored_bytes.load(std::memory_order_relaxed);
+      return stored ? (double)raw_bytes.load(std::memory_order_relaxed) / stored : 0;
+   }
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef SEQLOCK_H_
+#define SEQLOCK_H_
+
+// system
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+// seqlock publishes a small value from one writer at a time to any number of readers. Readers never block the writer,
+// they retry if a store overlapped their copy. The value is kept as relaxed atomic words so a torn copy is only ever
+// thrown away, never undefined. Writers must be serialized by the caller
+template <typename T>
+class SeqLock
+{
+   static_assert(std::is_trivially_copyable<T>::value, "seqlock values are copied word by word");
+
+private:
+   static const size_t WORDS = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+   // odd while a store is in progress
+   std::atomic<uint32_t> sequence;
+   std::atomic<uint32_t> words[WORDS];
+
+public:
+   SeqLock()
+   {
+      sequence.store(0, std::memory_order_relaxed);
+      for (size_t i = 0; i < WORDS; i++)
+         words[i].store(0, std::memory_order_relaxed);
+   }
+
+   void Store(const T& value)
+   {
+      uint32_t buffer[WORDS] = {};
+      uint32_t start = sequence.load(std::memory_order_relaxed);
+
+      memcpy(buffer, &value, sizeof(T));
+      sequence.store(start + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      for (size_t i = 0; i < WORDS; i++)
+         words[i].store(buffer[i], std::memory_order_relaxed);
+      sequence.store(start + 2, std::memory_order_release);
+   }
+
+   T Load() const
+   {
+      uint32_t buffer[WORDS];
+      uint32_t start, end;
+      T value;
+
+      do
+      {
+         start = sequence.load(std::memory_order_acquire);
+         for (size_t i = 0; i < WORDS; i++)
+            buffer[i] = words[i].load(std::memory_order_relaxed);
+         std::atomic_thread_fence(std::memory_order_acquire);
+         end = sequence.load(std::memory_order_relaxed);
+      } while ((start & 1) || start != end);
+
+      memcpy(&value, buffer, sizeof(T));
+      return value;
+   }
+};
+
+#endif
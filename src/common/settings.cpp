@@ -1,6 +1,7 @@
 #include <fstream>
 #include <iostream>
 
+#include "resampler.h"
 #include "settings.h"
 #include "util.h"
 
@@ -14,10 +15,34 @@ scale_mode_t scale_modes[] = {
    {"scale_mode_integer", SCALE_MODE_INTEGER},
    {"scale_mode_integer_overscale", SCALE_MODE_INTEGER_OVERSCALE}};
 
+setting_mode_t resampler_qualities[] = {
+   {"resampler_quality_linear", RESAMPLER_QUALITY_LINEAR},
+   {"resampler_quality_sinc", RESAMPLER_QUALITY_SINC}};
+
+setting_mode_t input_poll_modes[] = {
+   {"input_poll_mode_early", INPUT_POLL_EARLY},
+   {"input_poll_mode_normal", INPUT_POLL_NORMAL},
+   {"input_poll_mode_late", INPUT_POLL_LATE}};
+
 Setting<bool>* video_fullscreen;
 Setting<bool>* video_fullscreen_windowed;
 Setting<bool>* video_vsync;
+Setting<bool>* video_frame_limiter;
 Setting<scale_mode_t>* video_scale_mode;
+Setting<bool>* core_threaded;
+Setting<setting_mode_t>* audio_resampler_quality;
+Setting<bool>* audio_rate_control;
+Setting<bool>* rewind_enable;
+Setting<int>* rewind_buffer_size;
+Setting<int>* rewind_granularity;
+Setting<int>* runahead_frames;
+Setting<bool>* runahead_second_instance;
+Setting<int>* fastforward_ratio;
+Setting<setting_mode_t>* input_poll_mode;
+Setting<bool>* input_thread_enable;
+Setting<int>* input_thread_rate;
+Setting<int>* input_turbo_rate;
+Setting<int>* input_axis_threshold;
 
 void settings_init(std::string path)
 {
@@ -25,6 +50,26 @@ void settings_init(std::string path)
    video_fullscreen = new Setting<bool>("video_fullscreen", false, false);
    video_fullscreen_windowed = new Setting<bool>("video_fullscreen_windowed", true, true);
    video_vsync = new Setting<bool>("video_vsync", true, true);
-   video_scale_mode =
-      new Setting<scale_mode_t>("video_scale_mode", scale_modes[SCALE_MODE_INTEGER], scale_modes[SCALE_MODE_INTEGER]);
+   video_frame_limiter = new Setting<bool>("video_frame_limiter", true, true);
+   video_scale_mode = new Setting<scale_mode_t>(
+      "video_scale_mode", scale_modes[SCALE_MODE_INTEGER], scale_modes[SCALE_MODE_INTEGER], scale_modes,
+      SCALE_MODE_LAST);
+   core_threaded = new Setting<bool>("core_threaded", false, false);
+   audio_resampler_quality = new Setting<setting_mode_t>(
+      "audio_resampler_quality", resampler_qualities[RESAMPLER_QUALITY_SINC],
+      resampler_qualities[RESAMPLER_QUALITY_SINC], resampler_qualities, RESAMPLER_QUALITY_LAST);
+   audio_rate_control = new Setting<bool>("audio_rate_control", true, true);
+   rewind_enable = new Setting<bool>("rewind_enable", false, false);
+   rewind_buffer_size = new Setting<int>("rewind_buffer_size", 64, 64, 1, 1024, 1);
+   rewind_granularity = new Setting<int>("rewind_granularity", 1, 1, 1, 32, 1);
+   runahead_frames = new Setting<int>("runahead_frames", 0, 0, 0, 6, 1);
+   runahead_second_instance = new Setting<bool>("runahead_second_instance", false, false);
+   fastforward_ratio = new Setting<int>("fastforward_ratio", 4, 4, 0, 16, 1);
+   input_poll_mode = new Setting<setting_mode_t>(
+      "input_poll_mode", input_poll_modes[INPUT_POLL_LATE], input_poll_modes[INPUT_POLL_LATE], input_poll_modes,
+      INPUT_POLL_LAST);
+   input_thread_enable = new Setting<bool>("input_thread_enable", false, false);
+   input_thread_rate = new Setting<int>("input_thread_rate", 1000, 1000, 125, 8000, 125);
+   input_turbo_rate = new Setting<int>("input_turbo_rate", 10, 10, 1, 30, 1);
+   input_axis_threshold = new Setting<int>("input_axis_threshold", 25, 25, 5, 95, 5);
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <string>
 #include <type_traits>
+#include <vector>
 
 #include "toml++/toml.h"
 
@@ -20,11 +21,26 @@ enum scale_modes_enum
    SCALE_MODE_LAST,
 };
 
-typedef struct scale_mode
+// when the published physical input is read for a core frame
+enum input_poll_modes_enum
+{
+   // once per main loop iteration, before any core runs
+   INPUT_POLL_EARLY = 0,
+   // right before every core frame
+   INPUT_POLL_NORMAL,
+   // whenever the core polls during its frame
+   INPUT_POLL_LATE,
+   INPUT_POLL_LAST,
+};
+
+// an entry of a multiple choice setting, the name doubles as the localization key prefix
+typedef struct setting_mode
 {
    std::string m_name;
    int m_mode;
-} scale_mode_t;
+} setting_mode_t;
+
+typedef setting_mode_t scale_mode_t;
 
 template <typename T>
 class SettingBase
@@ -33,7 +49,7 @@ protected:
    T m_value{};
    T m_default{};
    std::string m_name{};
-   void (*setting_event)(void);
+   void (*setting_event)(void) = NULL;
 
 public:
    SettingBase(std::string name, T value, T def)
@@ -75,6 +91,8 @@ public:
       , m_max(std::move(max))
       , m_step(std::move(step))
    { }
+
+   bool Render();
 };
 
 template <>
@@ -89,21 +107,49 @@ public:
 };
 
 template <>
-class Setting<scale_mode_t>: public SettingBase<scale_mode_t>
+class Setting<setting_mode_t>: public SettingBase<setting_mode_t>
 {
+private:
+   const setting_mode_t* m_modes;
+   unsigned m_count;
+   // localization keys for every entry, kept alive since gettext hands back the key when there is no translation
+   std::vector<std::string> m_labels;
+
 public:
-   Setting(std::string name, scale_mode_t value, scale_mode_t def)
-      : SettingBase<scale_mode_t>(std::move(name), std::move(value), std::move(def))
-   { }
+   Setting(std::string name, setting_mode_t value, setting_mode_t def, const setting_mode_t* modes, unsigned count)
+      : SettingBase<setting_mode_t>(std::move(name), std::move(value), std::move(def))
+      , m_modes(modes)
+      , m_count(count)
+   {
+      for (unsigned i = 0; i < count; i++)
+         m_labels.push_back(modes[i].m_name + "_label");
+   }
 
    bool Render();
 };
 
 extern scale_mode_t scale_modes[];
+extern setting_mode_t resampler_qualities[];
+extern setting_mode_t input_poll_modes[];
 
 extern Setting<bool>* video_fullscreen;
 extern Setting<bool>* video_fullscreen_windowed;
 extern Setting<bool>* video_vsync;
+extern Setting<bool>* video_frame_limiter;
 extern Setting<scale_mode_t>* video_scale_mode;
+extern Setting<bool>* core_threaded;
+extern Setting<setting_mode_t>* audio_resampler_quality;
+extern Setting<bool>* audio_rate_control;
+extern Setting<bool>* rewind_enable;
+extern Setting<int>* rewind_buffer_size;
+extern Setting<int>* rewind_granularity;
+extern Setting<int>* runahead_frames;
+extern Setting<bool>* runahead_second_instance;
+extern Setting<int>* fastforward_ratio;
+extern Setting<setting_mode_t>* input_poll_mode;
+extern Setting<bool>* input_thread_enable;
+extern Setting<int>* input_thread_rate;
+extern Setting<int>* input_turbo_rate;
+extern Setting<int>* input_axis_threshold;
 
 #endif
\ No newline at end of file
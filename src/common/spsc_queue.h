@@ -0,0 +1,60 @@
+#ifndef SPSC_QUEUE_H_
+#define SPSC_QUEUE_H_
+
+// system
+#include <atomic>
+#include <stddef.h>
+#include <vector>
+
+// single producer single consumer queue. Neither side ever waits on the other, a push into a full queue fails and the
+// item is left to the producer. Which threads produce and consume may change as long as a handover synchronizes them
+template <typename T>
+class SpscQueue
+{
+private:
+   std::vector<T> items;
+   size_t mask;
+   // written by the producer and the consumer respectively, on separate cache lines so they don't contend
+   alignas(64) std::atomic<size_t> head;
+   alignas(64) std::atomic<size_t> tail;
+
+public:
+   // capacity is rounded up to a power of two
+   SpscQueue(size_t capacity)
+   {
+      size_t size = 1;
+
+      while (size < capacity)
+         size *= 2;
+      items.resize(size);
+      mask = size - 1;
+      head.store(0, std::memory_order_relaxed);
+      tail.store(0, std::memory_order_relaxed);
+   }
+
+   // producer side
+   bool Push(const T& item)
+   {
+      size_t position = head.load(std::memory_order_relaxed);
+
+      if (position - tail.load(std::memory_order_acquire) > mask)
+         return false;
+      items[position & mask] = item;
+      head.store(position + 1, std::memory_order_release);
+      return true;
+   }
+
+   // consumer side
+   bool Pop(T* item)
+   {
+      size_t position = tail.load(std::memory_order_relaxed);
+
+      if (position == head.load(std::memory_order_acquire))
+         return false;
+      *item = items[position & mask];
+      tail.store(position + 1, std::memory_order_release);
+      return true;
+   }
+};
+
+#endif
@@ -18,10 +18,11 @@ const char* logger_get_level_name(unsigned level)
 
 void logger(int level, const char* tag, const char* fmt, ...)
 {
-   static char previous_log[4096];
-   static char current_log[4096];
+   // spam suppression state is per thread, cores may log from their own threads
+   static thread_local char previous_log[4096];
+   static thread_local char current_log[4096];
 
-   static unsigned spam_count;
+   static thread_local unsigned spam_count;
 
    if (level >= log_level)
    {
@@ -53,52 +54,118 @@ log:
    }
 }
 
-void get_file_list(const char* in, file_list_t* out, const char* filter, bool include_dirs)
+bool read_directory(const char* path, file_entry_cb_t cb, void* data)
 {
    DIR* dir;
    struct dirent* entry;
-   unsigned i = 0;
+   char buf[PATH_MAX_LENGTH];
 
-   out->file_count = 0;
+   logger(LOG_DEBUG, tag, "reading directory %s\n", path);
+   dir = opendir(path);
+   if (!dir)
+      return false;
 
-   logger(LOG_DEBUG, tag, "reading directory %s\n", in);
-   dir = opendir(in);
-   if (dir != NULL)
+   while ((entry = readdir(dir)) != NULL)
    {
-      while ((entry = readdir(dir)) != NULL)
+      file_entry_t file;
+
+      file.name = entry->d_name;
+#ifdef _DIRENT_HAVE_D_TYPE
+      // only filesystems that don't report the type, or links, need a stat
+      if (entry->d_type != DT_UNKNOWN && entry->d_type != DT_LNK)
+         file.is_directory = entry->d_type == DT_DIR;
+      else
+#endif
       {
-         if (!string_is_empty(filter))
-         {
-            if (strstr(entry->d_name, filter))
-            {
-               strlcpy(out->file_names[i], entry->d_name, sizeof(char) * PATH_MAX_LENGTH);
-               i++;
-               out->file_count++;
-            }
-         }
-         else
-         {
-            if (!path_is_directory(entry->d_name))
-            {
-               strlcpy(out->file_names[i], entry->d_name, sizeof(char) * PATH_MAX_LENGTH);
-               i++;
-               out->file_count++;
-            }
-         }
-
-         if (include_dirs)
-         {
-            if (path_is_directory(entry->d_name))
-            {
-               strlcpy(out->file_names[i], entry->d_name, sizeof(char) * PATH_MAX_LENGTH);
-               i++;
-               out->file_count++;
-            }
-         }
+         fill_pathname_join(buf, path, entry->d_name, sizeof(buf));
+         file.is_directory = path_is_directory(buf);
       }
 
-      closedir(dir);
+      if (!cb(&file, data))
+         break;
+   }
+
+   closedir(dir);
+   return true;
+}
+
+static bool file_list_append(file_list_t* list, const char* name, bool is_directory)
+{
+   size_t size = strlen(name) + 1;
+
+   if (list->file_count == list->capacity)
+   {
+      unsigned capacity = list->capacity ? list->capacity * 2 : 64;
+      uint32_t* offsets = (uint32_t*)realloc(list->offsets, capacity * sizeof(uint32_t));
+
+      if (!offsets)
+         return false;
+      list->offsets = offsets;
+      list->capacity = capacity;
+   }
+
+   if (list->pool_size + size > list->pool_capacity)
+   {
+      size_t capacity = list->pool_capacity ? list->pool_capacity : 4096;
+      char* pool;
+
+      while (list->pool_size + size > capacity)
+         capacity *= 2;
+      if (capacity > ~FILE_LIST_DIRECTORY_FLAG || !(pool = (char*)realloc(list->pool, capacity)))
+         return false;
+      list->pool = pool;
+      list->pool_capacity = capacity;
+   }
+
+   memcpy(list->pool + list->pool_size, name, size);
+   list->offsets[list->file_count++] = list->pool_size | (is_directory ? FILE_LIST_DIRECTORY_FLAG : 0);
+   list->pool_size += size;
+   return true;
+}
+
+struct file_list_filter
+{
+   file_list_t* list;
+   const char* filter;
+   bool include_dirs;
+};
+
+static bool file_list_add_entry(const file_entry_t* entry, void* data)
+{
+   struct file_list_filter* state = (struct file_list_filter*)data;
+
+   if (entry->is_directory)
+   {
+      if (!state->include_dirs)
+         return true;
    }
+   else if (!string_is_empty(state->filter) && !strstr(entry->name, state->filter))
+      return true;
+
+   if (!file_list_append(state->list, entry->name, entry->is_directory))
+   {
+      logger(LOG_ERROR, tag, "out of memory listing %s\n", entry->name);
+      return false;
+   }
+   return true;
+}
+
+void get_file_list(const char* in, file_list_t* out, const char* filter, bool include_dirs)
+{
+   struct file_list_filter state = {out, filter, include_dirs};
+
+   // the pool and index are kept across calls, listing another directory reuses them
+   out->file_count = 0;
+   out->pool_size = 0;
+
+   read_directory(in, file_list_add_entry, &state);
+}
+
+void file_list_free(file_list_t* list)
+{
+   free(list->offsets);
+   free(list->pool);
+   memset(list, 0, sizeof(*list));
 }
 
 bool filename_supported(const char* filename, const char* extensions)
@@ -116,3 +183,37 @@ bool filename_supported(const char* filename, const char* extensions)
 
    return ret;
 }
+
+bool file_copy(const char* src, const char* dst)
+{
+   bool ret = false;
+   const size_t chunk = 64 * 1024;
+   char* buffer = (char*)malloc(chunk);
+   FILE* in = fopen(src, "rb");
+   FILE* out = fopen(dst, "wb");
+
+   if (!buffer || !in || !out)
+      logger(LOG_ERROR, tag, "error copying %s to %s\n", src, dst);
+   else
+   {
+      size_t read;
+
+      ret = true;
+      while ((read = fread(buffer, 1, chunk, in)) > 0)
+      {
+         if (fwrite(buffer, 1, read, out) != read)
+         {
+            logger(LOG_ERROR, tag, "error writing %s\n", dst);
+            ret = false;
+            break;
+         }
+      }
+   }
+
+   if (in)
+      fclose(in);
+   if (out)
+      fclose(out);
+   free(buffer);
+   return ret;
+}
@@ -4,6 +4,7 @@
 // system
 #include <dirent.h>
 #include <stdarg.h>
+#include <stdint.h>
 
 // libretro common
 #include <file/file_path.h>
@@ -28,20 +29,56 @@ enum logger_level
    LOG_ERROR
 };
 
+// directory entry as handed out while a directory is read, the name is only valid during the callback
+struct file_entry
+{
+   const char* name;
+   bool is_directory;
+} typedef file_entry_t;
+
+// return false to stop reading the directory
+typedef bool (*file_entry_cb_t)(const file_entry_t* entry, void* data);
+
+// directory listing, names are appended to one growable pool and addressed by offset so growing the pool never
+// invalidates an entry
 struct file_list
 {
    unsigned file_count;
-   char file_names[4096][PATH_MAX_LENGTH];
+   unsigned capacity;
+   // offset of every name in the pool, the top bit flags directories
+   uint32_t* offsets;
+   char* pool;
+   size_t pool_size;
+   size_t pool_capacity;
 } typedef file_list_t;
 
+#define FILE_LIST_DIRECTORY_FLAG 0x80000000u
+
 void logger_set_level(unsigned level);
 
 const char* logger_get_level_name(unsigned level);
 
 void logger(int level, const char* tag, const char* fmt, ...);
 
+// read a directory entry by entry as readdir produces them, directories are told apart by the entry type when the
+// filesystem reports it
+bool read_directory(const char* path, file_entry_cb_t cb, void* data);
+
 void get_file_list(const char* in, file_list_t* out, const char* filter, bool include_dirs);
+void file_list_free(file_list_t* list);
+
+static inline const char* file_list_get_name(const file_list_t* list, unsigned index)
+{
+   return list->pool + (list->offsets[index] & ~FILE_LIST_DIRECTORY_FLAG);
+}
+
+static inline bool file_list_is_directory(const file_list_t* list, unsigned index)
+{
+   return list->offsets[index] & FILE_LIST_DIRECTORY_FLAG;
+}
 
 bool filename_supported(const char* filename, const char* extensions);
 
+bool file_copy(const char* src, const char* dst);
+
 #endif
\ No newline at end of file
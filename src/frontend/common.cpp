@@ -13,6 +13,13 @@ SDL_GLContext invader_context = NULL;
 SDL_AudioSpec want, have;
 SDL_AudioDeviceID device;
 
+// audio sources are only changed with the device locked, so the callback sees a consistent list without locking
+static AudioRing* audio_sources[MAX_AUDIO_SOURCES];
+static unsigned audio_source_count = 0;
+// mixing scratch buffer, allocated when the device opens
+static int16_t* audio_mix_buffer = NULL;
+static size_t audio_mix_frames = 0;
+
 const char* vertex_shader_source =
    "#version 330 core\n"
    "layout (location = 0) in vec3 aPos;\n"
@@ -250,6 +257,39 @@ void render_framebuffer(unsigned texture_data, core_info_t* info)
    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 }
 
+// device pull callback, runs on the audio thread
+static void audio_device_callback(void* userdata, Uint8* stream, int len)
+{
+   int16_t* out = (int16_t*)stream;
+   size_t frames = len / (2 * sizeof(int16_t));
+
+   memset(stream, 0, len);
+
+   // a single source is read straight into the device buffer
+   if (audio_source_count == 1)
+   {
+      audio_sources[0]->Read(out, frames);
+      return;
+   }
+
+   while (frames > 0)
+   {
+      size_t chunk = MIN(frames, audio_mix_frames);
+
+      for (unsigned i = 0; i < audio_source_count; i++)
+      {
+         size_t read = audio_sources[i]->Read(audio_mix_buffer, chunk);
+         for (size_t j = 0; j < read * 2; j++)
+         {
+            int sample = out[j] + audio_mix_buffer[j];
+            out[j] = sample > INT16_MAX ? INT16_MAX : sample < INT16_MIN ? INT16_MIN : sample;
+         }
+      }
+      out += chunk * 2;
+      frames -= chunk;
+   }
+}
+
 bool create_audio_device()
 {
    if (SDL_Init(SDL_INIT_AUDIO) == -1)
@@ -277,8 +317,8 @@ bool create_audio_device()
    want.freq = 48000;
    want.format = AUDIO_S16;
    want.channels = 2;
-   want.samples = 4096;
-   want.callback = NULL;
+   want.samples = 1024;
+   want.callback = audio_device_callback;
 
    logger(
       LOG_INFO, tag, "want - frequency: %d format: f %d s %d be %d sz %d channels: %d samples: %d\n", want.freq,
@@ -301,10 +341,82 @@ bool create_audio_device()
       SDL_AUDIO_ISFLOAT(have.format), SDL_AUDIO_ISSIGNED(have.format), SDL_AUDIO_ISBIGENDIAN(have.format),
       SDL_AUDIO_BITSIZE(have.format), have.channels, have.samples);
 
+   audio_mix_frames = have.samples;
+   audio_mix_buffer = (int16_t*)calloc(audio_mix_frames * 2, sizeof(int16_t));
+   if (!audio_mix_buffer)
+   {
+      logger(LOG_ERROR, tag, "failed to allocate audio mixing buffer\n");
+      destroy_audio_device();
+      return false;
+   }
+
    SDL_PauseAudioDevice(device, 0);
    return true;
 }
 
+void destroy_audio_device()
+{
+   if (device)
+   {
+      SDL_CloseAudioDevice(device);
+      device = 0;
+   }
+   free(audio_mix_buffer);
+   audio_mix_buffer = NULL;
+   audio_mix_frames = 0;
+   audio_source_count = 0;
+}
+
+unsigned get_audio_device_rate()
+{
+   return have.freq;
+}
+
+unsigned get_audio_device_samples()
+{
+   return have.samples;
+}
+
+bool audio_register_source(AudioRing* ring)
+{
+   bool ret = false;
+
+   if (!device)
+      return ret;
+
+   SDL_LockAudioDevice(device);
+   if (audio_source_count < MAX_AUDIO_SOURCES)
+   {
+      audio_sources[audio_source_count++] = ring;
+      ret = true;
+   }
+   SDL_UnlockAudioDevice(device);
+
+   if (!ret)
+      logger(LOG_WARN, tag, "too many audio sources, %d max\n", MAX_AUDIO_SOURCES);
+   return ret;
+}
+
+void audio_unregister_source(AudioRing* ring)
+{
+   if (!device)
+      return;
+
+   SDL_LockAudioDevice(device);
+   for (unsigned i = 0; i < audio_source_count; i++)
+   {
+      if (audio_sources[i] == ring)
+      {
+         // the device lock keeps the callback out, this is the consumer side now. A ring registered again starts
+         // with what was written after that instead of stale frames
+         audio_sources[i] = audio_sources[--audio_source_count];
+         ring->Clear();
+         break;
+      }
+   }
+   SDL_UnlockAudioDevice(device);
+}
+
 void set_fullscreen_mode()
 {
    bool fullscreen = video_fullscreen->GetValue();
@@ -325,6 +437,15 @@ void set_vsync_mode()
    SDL_GL_SetSwapInterval(vsync ? 1 : 0);
 }
 
+double get_display_refresh_rate()
+{
+   SDL_DisplayMode mode;
+
+   if (!invader_window || SDL_GetWindowDisplayMode(invader_window, &mode) != 0 || mode.refresh_rate <= 0)
+      return 60.0;
+   return mode.refresh_rate;
+}
+
 SDL_GLContext get_context()
 {
    return invader_context;
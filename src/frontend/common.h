@@ -11,6 +11,7 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_opengl.h>
 
+#include "audio_ring.h"
 #include "libretro/piccolo.h"
 #include "settings.h"
 #include "util.h"
@@ -32,6 +33,8 @@
 #define MAX_VERTEX_BUFFER 512 * 1024
 #define MAX_ELEMENT_BUFFER 128 * 1024
 
+#define MAX_AUDIO_SOURCES 16
+
 extern SDL_Window* invader_window;
 extern SDL_GLContext invader_context;
 
@@ -52,10 +55,20 @@ void render_framebuffer(unsigned texture_data, core_info_t* info);
 
 // audio device creation
 bool create_audio_device();
+void destroy_audio_device();
+unsigned get_audio_device_rate();
+// frames pulled by every device callback
+unsigned get_audio_device_samples();
+
+// audio sources, every registered ring is drained and mixed by the device callback
+bool audio_register_source(AudioRing* ring);
+void audio_unregister_source(AudioRing* ring);
 
 // video utilities
 void set_fullscreen_mode();
 void set_vsync_mode();
+// refresh rate of the display the window is on, 60Hz when unknown
+double get_display_refresh_rate();
 
 // configuration management
 void common_config_load();
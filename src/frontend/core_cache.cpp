@@ -0,0 +1,176 @@
+// system
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "core_cache.h"
+
+static const char* tag = "[cache]";
+
+CoreCache::CoreCache()
+{
+   entries = NULL;
+   count = 0;
+}
+
+bool CoreCache::Load(const char* path)
+{
+   entries = NULL;
+   count = 0;
+
+   if (!path_is_valid(path) || !file.Open(path))
+      return false;
+
+   const uint8_t* data = (const uint8_t*)file.GetData();
+   size_t size = file.GetSize();
+   const core_cache_header_t* header = (const core_cache_header_t*)data;
+
+   // every string offset is checked against the file size and the file ends in a terminator, so strings read from
+   // a truncated or corrupted file can't run past the mapping
+   if (size < sizeof(core_cache_header_t) || memcmp(header->magic, CORE_CACHE_MAGIC, sizeof(header->magic)) ||
+       header->version != CORE_CACHE_VERSION ||
+       header->count > (size - sizeof(core_cache_header_t)) / sizeof(core_cache_entry_t) || data[size - 1] != '\0')
+   {
+      logger(LOG_WARN, tag, "ignoring invalid cache %s\n", path);
+      file.Close();
+      return false;
+   }
+
+   const core_cache_entry_t* list = (const core_cache_entry_t*)(header + 1);
+   for (size_t i = 0; i < header->count; i++)
+   {
+      if (list[i].path >= size || list[i].core_name >= size || list[i].core_version >= size ||
+          list[i].extensions >= size)
+      {
+         logger(LOG_WARN, tag, "ignoring invalid cache %s\n", path);
+         file.Close();
+         return false;
+      }
+   }
+
+   entries = list;
+   count = header->count;
+   logger(LOG_DEBUG, tag, "%u cores cached in %s\n", (unsigned)count, path);
+   return true;
+}
+
+bool CoreCache::Find(const char* path, const core_cache_key_t* key, core_scan_result_t* result)
+{
+   size_t low = 0;
+   size_t high = count;
+
+   while (low < high)
+   {
+      size_t middle = low + (high - low) / 2;
+      int order = strcmp(GetString(entries[middle].path), path);
+
+      if (order < 0)
+         low = middle + 1;
+      else if (order > 0)
+         high = middle;
+      else
+      {
+         const core_cache_entry_t* entry = &entries[middle];
+
+         if (memcmp(&entry->key, key, sizeof(*key)))
+            return false;
+
+         memset(result, 0, sizeof(*result));
+         result->ok = entry->ok;
+         strlcpy(result->info.file_name, path, sizeof(result->info.file_name));
+         strlcpy(result->info.core_name, GetString(entry->core_name), sizeof(result->info.core_name));
+         strlcpy(result->info.core_version, GetString(entry->core_version), sizeof(result->info.core_version));
+         strlcpy(result->info.extensions, GetString(entry->extensions), sizeof(result->info.extensions));
+         result->info.supports_no_game = entry->supports_no_game;
+         result->info.block_extract = entry->block_extract;
+         result->info.full_path = entry->full_path;
+         return true;
+      }
+   }
+
+   return false;
+}
+
+// appends a string to the pool, returns its offset in the file
+static uint32_t pool_add(std::vector<char>& pool, size_t base, const char* str)
+{
+   uint32_t offset = base + pool.size();
+
+   pool.insert(pool.end(), str, str + strlen(str) + 1);
+   return offset;
+}
+
+bool CoreCache::Save(
+   const char* path, const char* const* paths, const core_cache_key_t* keys, const core_scan_result_t* results,
+   size_t count)
+{
+   char temp[PATH_MAX_LENGTH];
+   core_cache_header_t header = {};
+   std::vector<core_cache_entry_t> list(count);
+   std::vector<char> pool;
+   size_t base = sizeof(header) + count * sizeof(core_cache_entry_t);
+   bool ret = false;
+
+   memcpy(header.magic, CORE_CACHE_MAGIC, sizeof(header.magic));
+   header.version = CORE_CACHE_VERSION;
+   header.count = count;
+
+   // the pool starts with an empty string so failed cores have something to point at
+   pool.push_back('\0');
+   for (size_t i = 0; i < count; i++)
+   {
+      const core_info_t* info = &results[i].info;
+
+      list[i].key = keys[i];
+      list[i].path = pool_add(pool, base, paths[i]);
+      list[i].core_name = results[i].ok ? pool_add(pool, base, info->core_name) : base;
+      list[i].core_version = results[i].ok ? pool_add(pool, base, info->core_version) : base;
+      list[i].extensions = results[i].ok ? pool_add(pool, base, info->extensions) : base;
+      list[i].ok = results[i].ok;
+      list[i].supports_no_game = info->supports_no_game;
+      list[i].block_extract = info->block_extract;
+      list[i].full_path = info->full_path;
+   }
+
+   // written next to the cache and renamed over it, readers only ever see a complete file
+   snprintf(temp, sizeof(temp), "%s.%d.tmp", path, (int)getpid());
+   FILE* out = fopen(temp, "wb");
+   if (out)
+   {
+      ret = fwrite(&header, sizeof(header), 1, out) == 1 &&
+            (!count || fwrite(list.data(), sizeof(core_cache_entry_t), count, out) == count) &&
+            fwrite(pool.data(), 1, pool.size(), out) == pool.size();
+      ret = fclose(out) == 0 && ret;
+   }
+#ifdef _WIN32
+   // rename doesn't replace existing files on windows
+   if (ret)
+      remove(path);
+#endif
+   if (ret && rename(temp, path) != 0)
+      ret = false;
+
+   if (!ret)
+   {
+      logger(LOG_WARN, tag, "error writing cache %s\n", path);
+      remove(temp);
+   }
+   else
+      logger(LOG_DEBUG, tag, "%u cores written to %s\n", (unsigned)count, path);
+   return ret;
+}
+
+bool core_cache_get_key(const char* path, core_cache_key_t* key)
+{
+   struct stat st;
+
+   memset(key, 0, sizeof(*key));
+   if (stat(path, &st) != 0)
+      return false;
+
+   key->mtime = st.st_mtime;
+   key->size = st.st_size;
+   key->inode = st.st_ino;
+   return true;
+}
@@ -0,0 +1,75 @@
+#ifndef CORE_CACHE_H_
+#define CORE_CACHE_H_
+
+// system
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core_scanner.h"
+#include "mapped_file.h"
+
+#define CORE_CACHE_FILE "core_info.cache"
+#define CORE_CACHE_MAGIC "INVCORES"
+#define CORE_CACHE_VERSION 1
+
+// identifies a core library on disk, a core whose key changed is peeked again
+typedef struct core_cache_key
+{
+   uint64_t mtime;
+   uint64_t size;
+   uint64_t inode;
+} core_cache_key_t;
+
+typedef struct core_cache_header
+{
+   char magic[8];
+   uint32_t version;
+   uint32_t count;
+} core_cache_header_t;
+
+// strings are offsets from the start of the file into the string pool that follows the entries
+typedef struct core_cache_entry
+{
+   core_cache_key_t key;
+   uint32_t path;
+   uint32_t core_name;
+   uint32_t core_version;
+   uint32_t extensions;
+   uint8_t ok;
+   uint8_t supports_no_game;
+   uint8_t block_extract;
+   uint8_t full_path;
+   uint8_t padding[4];
+} core_cache_entry_t;
+
+// core cache keeps the result of peeking every core across launches. The file is a header, the entries sorted by
+// path and a pool of strings, it is mapped and searched in place, nothing is parsed up front. Libraries that failed
+// to load are remembered too so they are not retried until they change
+class CoreCache
+{
+private:
+   MappedFile file;
+   const core_cache_entry_t* entries;
+   size_t count;
+
+   const char* GetString(uint32_t offset) { return (const char*)file.GetData() + offset; }
+
+public:
+   CoreCache();
+
+   // map a cache file, a missing or invalid file leaves the cache empty
+   bool Load(const char* path);
+   size_t GetCount() { return count; }
+   // fill result from the cache if the core is known and unchanged
+   bool Find(const char* path, const core_cache_key_t* key, core_scan_result_t* result);
+
+   // write a cache for the given cores, paths must be sorted. The file is replaced atomically
+   static bool Save(
+      const char* path, const char* const* paths, const core_cache_key_t* keys, const core_scan_result_t* results,
+      size_t count);
+};
+
+// read the key of a file on disk
+bool core_cache_get_key(const char* path, core_cache_key_t* key);
+
+#endif
@@ -0,0 +1,130 @@
+// system
+#include <algorithm>
+#include <mutex>
+#include <sys/stat.h>
+
+#include "core_cache.h"
+#include "core_catalog.h"
+
+static const char* tag = "[catalog]";
+
+// the catalog every instance shares, read and replaced with the atomic shared_ptr functions
+static std::shared_ptr<const CoreCatalog> current_catalog;
+// only one thread scans, the others wait for its result instead of scanning the same directory again
+static std::mutex scan_lock;
+
+static uint64_t directory_mtime(const char* path)
+{
+   struct stat st;
+
+   return stat(path, &st) == 0 ? (uint64_t)st.st_mtime : 0;
+}
+
+CoreCatalog::CoreCatalog(const char* path)
+{
+   this->path = path;
+   mtime = directory_mtime(path);
+   Scan();
+}
+
+void CoreCatalog::Scan()
+{
+   char buf[PATH_MAX_LENGTH];
+   file_list_t core_list = {};
+#ifdef _WIN32
+   get_file_list(path.c_str(), &core_list, ".dll", false);
+#else
+   get_file_list(path.c_str(), &core_list, ".so", false);
+#endif
+
+   logger(LOG_DEBUG, tag, "core count: %d\n", core_list.file_count);
+   if (core_list.file_count == 0)
+   {
+      file_list_free(&core_list);
+      return;
+   }
+
+   // sorted by file name so the catalog is the same whatever order the directory is read in
+   std::vector<std::string> paths(core_list.file_count);
+   std::vector<const char*> path_list(core_list.file_count);
+   std::vector<core_scan_result_t> results(core_list.file_count);
+   std::vector<core_cache_key_t> keys(core_list.file_count);
+
+   for (unsigned i = 0; i < core_list.file_count; i++)
+   {
+      snprintf(buf, sizeof(buf), "%s/%s", path.c_str(), file_list_get_name(&core_list, i));
+      paths[i] = buf;
+   }
+   file_list_free(&core_list);
+   std::sort(paths.begin(), paths.end());
+   for (size_t i = 0; i < paths.size(); i++)
+      path_list[i] = paths[i].c_str();
+
+   // only cores that are new or changed since the last launch are loaded, the rest come from the cache
+   CoreCache cache;
+   std::vector<const char*> pending;
+   std::vector<size_t> pending_index;
+
+   cache.Load(CORE_CACHE_FILE);
+   for (size_t i = 0; i < path_list.size(); i++)
+   {
+      core_cache_get_key(path_list[i], &keys[i]);
+      if (!cache.Find(path_list[i], &keys[i], &results[i]))
+      {
+         pending.push_back(path_list[i]);
+         pending_index.push_back(i);
+      }
+   }
+   logger(
+      LOG_INFO, tag, "%u cores cached, %u to scan\n", (unsigned)(path_list.size() - pending.size()),
+      (unsigned)pending.size());
+
+   if (!pending.empty())
+   {
+      std::vector<core_scan_result_t> scanned(pending.size());
+
+      core_scan(pending.data(), pending.size(), scanned.data());
+      for (size_t i = 0; i < pending.size(); i++)
+         results[pending_index[i]] = scanned[i];
+   }
+   // cores that went away also call for a new cache
+   if (!pending.empty() || cache.GetCount() != path_list.size())
+      CoreCache::Save(CORE_CACHE_FILE, path_list.data(), keys.data(), results.data(), path_list.size());
+
+   for (const core_scan_result_t& result : results)
+   {
+      if (!result.ok)
+         continue;
+
+      core_catalog_entry_t entry;
+      entry.file_name = Intern(result.info.file_name);
+      entry.core_name = Intern(result.info.core_name);
+      entry.core_version = Intern(result.info.core_version);
+      entry.extensions = Intern(result.info.extensions);
+      entry.supports_no_game = result.info.supports_no_game;
+      entry.block_extract = result.info.block_extract;
+      entry.full_path = result.info.full_path;
+      entries.push_back(entry);
+      names.push_back(entry.core_name);
+   }
+
+   logger(LOG_DEBUG, tag, "cores found: %u\n", (unsigned)entries.size());
+}
+
+std::shared_ptr<const CoreCatalog> CoreCatalog::Get(const char* path)
+{
+   std::shared_ptr<const CoreCatalog> catalog = std::atomic_load(&current_catalog);
+
+   if (catalog && catalog->path == path && catalog->mtime == directory_mtime(path))
+      return catalog;
+
+   std::lock_guard<std::mutex> lock(scan_lock);
+   // another thread may have scanned while this one waited
+   catalog = std::atomic_load(&current_catalog);
+   if (catalog && catalog->path == path && catalog->mtime == directory_mtime(path))
+      return catalog;
+
+   catalog = std::make_shared<const CoreCatalog>(path);
+   std::atomic_store(&current_catalog, catalog);
+   return catalog;
+}
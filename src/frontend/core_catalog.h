@@ -0,0 +1,52 @@
+#ifndef CORE_CATALOG_H_
+#define CORE_CATALOG_H_
+
+// system
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "core_scanner.h"
+
+typedef struct core_catalog_entry
+{
+   const char* file_name;
+   const char* core_name;
+   const char* core_version;
+   const char* extensions;
+   bool supports_no_game;
+   bool block_extract;
+   bool full_path;
+} core_catalog_entry_t;
+
+// core catalog lists the cores found in a directory. A catalog never changes once built and is shared by every
+// instance, a directory that changed gets a new catalog swapped in while the old one lives on for as long as
+// someone still holds it. Strings are interned, names or versions shared by several cores are stored once
+class CoreCatalog
+{
+private:
+   // node based, so pointers to the strings stay valid as more are added
+   std::unordered_set<std::string> strings;
+   std::vector<core_catalog_entry_t> entries;
+   // core names in catalog order, ready for a combo box
+   std::vector<const char*> names;
+   std::string path;
+   // modification time of the directory when it was scanned
+   uint64_t mtime;
+
+   const char* Intern(const char* str) { return strings.insert(str ? str : "").first->c_str(); }
+   void Scan();
+
+public:
+   CoreCatalog(const char* path);
+
+   size_t GetCount() const { return entries.size(); }
+   const core_catalog_entry_t* GetEntry(size_t index) const { return &entries[index]; }
+   const char* const* GetNames() const { return names.data(); }
+
+   // catalog for path, scanned the first time and again whenever the directory changed
+   static std::shared_ptr<const CoreCatalog> Get(const char* path);
+};
+
+#endif
@@ -0,0 +1,63 @@
+// system
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "core_scanner.h"
+
+static const char* tag = "[scanner]";
+
+static void core_scan_worker(
+   const char* const* paths, size_t count, core_scan_result_t* results, std::atomic<size_t>* next)
+{
+   Piccolo* piccolo = PiccoloPool::get()->acquire();
+
+   // workers pull the next core as they go so one slow core doesn't hold back a whole share of the list
+   for (size_t i = next->fetch_add(1); i < count; i = next->fetch_add(1))
+   {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+      results[i].ok = piccolo->load_game(paths[i], NULL, true);
+      if (results[i].ok)
+         memcpy(&results[i].info, piccolo->get_info(), sizeof(core_info_t));
+      results[i].ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+   }
+
+   PiccoloPool::get()->release(piccolo);
+}
+
+void core_scan(const char* const* paths, size_t count, core_scan_result_t* results)
+{
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+   std::atomic<size_t> next(0);
+   std::vector<std::thread> workers;
+   unsigned threads = std::max(1u, std::min(std::thread::hardware_concurrency(), (unsigned)CORE_SCANNER_MAX_THREADS));
+
+   if (count == 0)
+      return;
+
+   threads = std::min(threads, (unsigned)count);
+   for (unsigned i = 1; i < threads; i++)
+      workers.emplace_back(core_scan_worker, paths, count, results, &next);
+   // the calling thread takes a share too
+   core_scan_worker(paths, count, results, &next);
+   for (std::thread& worker : workers)
+      worker.join();
+
+   size_t slowest = 0;
+   for (size_t i = 0; i < count; i++)
+   {
+      logger(
+         results[i].ok ? LOG_DEBUG : LOG_WARN, tag, "%s %s in %.3fms\n", paths[i],
+         results[i].ok ? "peeked" : "failed", results[i].ms);
+      if (results[i].ms > results[slowest].ms)
+         slowest = i;
+   }
+
+   logger(
+      LOG_INFO, tag, "%u cores scanned on %u threads in %.3fms, slowest %s %.3fms\n", (unsigned)count, threads,
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(), paths[slowest],
+      results[slowest].ms);
+}
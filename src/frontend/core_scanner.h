@@ -0,0 +1,24 @@
+#ifndef CORE_SCANNER_H_
+#define CORE_SCANNER_H_
+
+// system
+#include <stddef.h>
+
+#include "libretro/piccolo.h"
+
+// upper bound on threads peeking cores, loading libraries is mostly disk and dynamic linker bound
+#define CORE_SCANNER_MAX_THREADS 8
+
+typedef struct core_scan_result
+{
+   core_info_t info;
+   bool ok;
+   // time spent loading the library and querying it, in milliseconds
+   double ms;
+} core_scan_result_t;
+
+// peek every core in paths, spread over a pool of worker threads. Every worker loads, queries and closes its own
+// cores, results land at the same index as their path so the outcome doesn't depend on scheduling
+void core_scan(const char* const* paths, size_t count, core_scan_result_t* results);
+
+#endif
@@ -0,0 +1,64 @@
+#include "frame_mailbox.h"
+
+static const char* tag = "[mailbox]";
+
+FrameMailbox::FrameMailbox()
+{
+   for (unsigned i = 0; i < 3; i++)
+   {
+      frames[i].data = NULL;
+      frames[i].width = 0;
+      frames[i].height = 0;
+      frames[i].pitch = 0;
+      capacity[i] = 0;
+   }
+
+   write_index = 0;
+   read_index = 1;
+   ready_index.store(2, std::memory_order_relaxed);
+}
+
+FrameMailbox::~FrameMailbox()
+{
+   for (unsigned i = 0; i < 3; i++)
+      free((void*)frames[i].data);
+}
+
+void FrameMailbox::Publish(const core_frame_buffer_t* frame)
+{
+   // duped frames carry no data, the consumer keeps showing the previous one
+   if (!frame->data)
+      return;
+
+   core_frame_buffer_t* slot = &frames[write_index];
+   size_t size = (size_t)frame->pitch * frame->height;
+
+   // slots only grow, geometry changes are rare so this settles after the first few frames
+   if (size > capacity[write_index])
+   {
+      void* data = realloc((void*)slot->data, size);
+      if (!data)
+      {
+         logger(LOG_ERROR, tag, "failed to allocate %u bytes for frame\n", (unsigned)size);
+         return;
+      }
+      slot->data = data;
+      capacity[write_index] = size;
+   }
+
+   memcpy((void*)slot->data, frame->data, size);
+   slot->width = frame->width;
+   slot->height = frame->height;
+   slot->pitch = frame->pitch;
+
+   write_index = ready_index.exchange(write_index | FRESH, std::memory_order_acq_rel) & ~FRESH;
+}
+
+core_frame_buffer_t* FrameMailbox::Consume()
+{
+   if (!(ready_index.load(std::memory_order_relaxed) & FRESH))
+      return NULL;
+
+   read_index = ready_index.exchange(read_index, std::memory_order_acq_rel) & ~FRESH;
+   return &frames[read_index];
+}
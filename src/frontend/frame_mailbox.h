@@ -0,0 +1,38 @@
+#ifndef FRAME_MAILBOX_H_
+#define FRAME_MAILBOX_H_
+
+// system
+#include <atomic>
+
+#include "libretro/piccolo.h"
+
+// frame mailbox hands finished video frames from a core thread to the thread that uploads them. It is a triple
+// buffer: the producer always has a slot to write to and the consumer always gets the most recent complete frame,
+// neither side ever waits on the other and frames the consumer never picked up are simply overwritten
+class FrameMailbox
+{
+private:
+   // bit set in the shared index when the slot behind it has not been consumed yet
+   static const unsigned FRESH = 4;
+
+   core_frame_buffer_t frames[3];
+   size_t capacity[3];
+
+   // slot owned by the producer
+   unsigned write_index;
+   // slot owned by the consumer
+   unsigned read_index;
+   // slot in transit between both sides
+   std::atomic<unsigned> ready_index;
+
+public:
+   FrameMailbox();
+   ~FrameMailbox();
+
+   // producer side, copies the frame into the back slot and publishes it
+   void Publish(const core_frame_buffer_t* frame);
+   // consumer side, returns the latest published frame or NULL if nothing new arrived since the last call
+   core_frame_buffer_t* Consume();
+};
+
+#endif
@@ -57,7 +57,10 @@ void texture_list_init(const char* path)
 unsigned Kami::RenderVideo(unsigned* output)
 {
    unsigned pixel_format = core_info->pixel_format;
-   core_frame_buffer_t* video_data = piccolo->get_video_data();
+
+   // nothing to upload for duped frames, keep the previous texture
+   if (!video_data || !video_data->data)
+      return (*output);
 
    if (*output == 0)
       glGenTextures(1, (GLuint*)output);
@@ -95,21 +98,53 @@ unsigned Kami::RenderVideo(unsigned* output)
    return (*output);
 }
 
-void Kami::InputPoll()
-{ }
-
-void Kami::Main()
+void Kami::Main(double loop_rate)
 {
-   if (core_loaded)
+   // a core being loaded in the background is only picked up once it is ready
+   if (JobUpdate() || !core_loaded)
    {
-      status = piccolo->get_status();
+      AudioUpdate(false);
+      InputIdle();
+      return;
+   }
 
-      if (status == CORE_STATUS_LOADED || status == CORE_STATUS_RUNNING)
-      {
-         piccolo->core_run(NULL);
-         RenderVideo(&texture_data);
-      }
+   status = piccolo->get_status();
+   if (status != CORE_STATUS_LOADED && status != CORE_STATUS_RUNNING)
+   {
+      AudioUpdate(false);
+      InputIdle();
+      return;
    }
+
+   AudioUpdate(true);
+   InputLatch();
+
+   if (threaded)
+   {
+      // the worker runs the core, only upload the latest frame it finished
+      StartWorker();
+      video_data = mailbox.Consume();
+   }
+   else
+   {
+      StopWorker();
+
+      // only the last frame is uploaded, none at all if the core is not due this iteration
+      unsigned frames = FramesDue(loop_rate);
+      video_data = NULL;
+      for (unsigned i = 0; i < frames; i++)
+         video_data = RunFrame();
+   }
+   RenderVideo(&texture_data);
+}
+
+void Kami::RenderJobProgress()
+{
+   static const char* stages[] = {"core_load_stage_none", "core_load_stage_library", "core_load_stage_init",
+      "core_load_stage_content", "core_load_stage_game", "core_load_stage_done"};
+   unsigned stage = MIN(job_piccolo->get_load_stage(), (unsigned)CORE_LOAD_DONE);
+
+   ImGui::ProgressBar((float)stage / CORE_LOAD_DONE, ImVec2(-FLT_MIN, 0), _(stages[stage]));
 }
 
 void Kami::RenderGui(const char* title)
@@ -122,9 +157,6 @@ void Kami::RenderGui(const char* title)
    bool block_extract;
    bool full_path;
 
-   unsigned option_count;
-   core_option_t* options;
-
    static int padding = ImGui::GetStyle().WindowPadding.x;
 
    ImGui::SetNextWindowSizeConstraints(ImVec2(640 + padding * 2, 100), ImVec2(640 + padding * 2, 900));
@@ -142,23 +174,16 @@ void Kami::RenderGui(const char* title)
       bool block_extract = core_info->block_extract;
       bool full_path = core_info->full_path;
 
-      size_t option_count = piccolo->get_option_count();
-      core_option_t* options = piccolo->get_options();
-
-      size_t controller_port_count = piccolo->get_controller_port_count();
-      controller_info_t* controllers = piccolo->get_controller_info();
-
       switch (status)
       {
          case CORE_STATUS_NONE:
          {
-            ImGui::Combo(_("core_selector_label"), &current_core, core_entries, core_count);
+            ImGui::Combo(_("core_selector_label"), &current_core, catalog->GetNames(), core_count);
             Widgets::Tooltip(_("core_selector_desc"));
-            if (previous_core != current_core || previous_core == -1)
+            // a new selection is picked up once the job in progress finished
+            if ((previous_core != current_core || previous_core == -1) && !job_running)
             {
-               core_info = &core_info_list[current_core];
-               piccolo->unload_core();
-               core_loaded = piccolo->peek_core(core_info->file_name);
+               JobStart(catalog->GetEntry(current_core)->file_name, NULL, true);
                previous_core = current_core;
             }
             ImGui::LabelText(_("core_current_version_label"), core_version);
@@ -166,15 +191,16 @@ void Kami::RenderGui(const char* title)
             ImGui::LabelText(_("core_current_extensions_label"), supported_extensions);
             Widgets::Tooltip(_("core_current_extensions_desc"));
 
+            if (job_running)
+            {
+               RenderJobProgress();
+               break;
+            }
+
             if (supports_no_game)
             {
                if (ImGui::Button(_("core_current_start_core_label"), ImVec2(120, 0)))
-               {
-                  piccolo->unload_core();
-                  piccolo->set_callbacks(InputPoll);
-                  piccolo->load_game(core_info->file_name, NULL, frontend_supports_bitmasks);
-                  core_info = piccolo->get_info();
-               }
+                  JobStart(catalog->GetEntry(current_core)->file_name, NULL, false);
                Widgets::Tooltip(_("core_current_start_core_desc"));
             }
             if (
@@ -190,11 +216,8 @@ void Kami::RenderGui(const char* title)
             Widgets::Tooltip(_("core_current_load_content_desc"));
             if (!file_open_dialog_is_open && file_open_dialog_result_ok)
             {
-               piccolo->unload_core();
-               core_info = &core_info_list[current_core];
-               piccolo->set_callbacks(InputPoll);
-               piccolo->load_game(core_info->file_name, content_file_name, frontend_supports_bitmasks);
-               core_info = piccolo->get_info();
+               file_open_dialog_result_ok = false;
+               JobStart(catalog->GetEntry(current_core)->file_name, content_file_name, false);
             }
 #ifdef DEBUG
             // frontend flags
@@ -233,11 +256,42 @@ void Kami::RenderGui(const char* title)
                   image_texture, ImVec2((float)640, (float)640 / aspect), ImVec2(0.0f, 0.0f), ImVec2(1.0f, 1.0f),
                   ImVec4(1.0f, 1.0f, 1.0f, 1.0f), ImVec4(1.0f, 1.0f, 1.0f, 1.0f));
             }
+            // content being swapped, the core is busy until the job finished
+            if (job_running)
+            {
+               RenderJobProgress();
+               break;
+            }
+            bool rewind_held = false;
             if (ImGui::CollapsingHeader(_("core_current_actions_label"), ImGuiTreeNodeFlags_None))
             {
                if (ImGui::Button(_("core_current_reset_core_label"), ImVec2(240, 0)))
-                  piccolo->core_reset();
+                  Reset();
                Widgets::Tooltip(_("core_current_reset_core_desc"));
+               if (
+                  !(string_is_equal(supported_extensions, "N/A"))
+                  && ImGui::Button(_("core_current_swap_content_label"), ImVec2(240, 0)) && !file_open_dialog_is_open)
+               {
+                  ImGui::OpenPopup(_("window_title_file_selector"));
+                  file_open_dialog_is_open = true;
+               }
+               Widgets::Tooltip(_("core_current_swap_content_desc"));
+               bool skipping = GetFastForward();
+               if (ImGui::Checkbox(_("core_current_fastforward_label"), &skipping))
+                  SetFastForward(skipping);
+               Widgets::Tooltip(_("core_current_fastforward_desc"));
+               if (rewind_enabled.load(std::memory_order_relaxed))
+               {
+                  ImGui::Button(_("core_current_rewind_label"), ImVec2(240, 0));
+                  rewind_held = ImGui::IsItemActive();
+                  Widgets::Tooltip(_("core_current_rewind_desc"));
+               }
+            }
+            SetRewinding(rewind_held);
+            if (!file_open_dialog_is_open && file_open_dialog_result_ok)
+            {
+               file_open_dialog_result_ok = false;
+               SwapContent(content_file_name);
             }
             if (ImGui::CollapsingHeader(_("core_current_input_label"), ImGuiTreeNodeFlags_None))
             {
@@ -247,6 +301,13 @@ void Kami::RenderGui(const char* title)
 
                ImGui::Indent(ImGui::GetTreeNodeToLabelSpacing());
 
+               // the controller info belongs to the core, a port change is applied once it is released
+               std::unique_lock<std::mutex> lock = LockCore();
+               size_t controller_port_count = piccolo->get_controller_port_count();
+               controller_info_t* controllers = piccolo->get_controller_info();
+               int changed_port = -1;
+               unsigned changed_device = 0;
+
                for (unsigned i = 0; i < controller_port_count; i++)
                {
                   char buf[100];
@@ -273,28 +334,35 @@ void Kami::RenderGui(const char* title)
                         const char* desc = controllers[i].types[index].desc;
 
                         logger(LOG_DEBUG, tag, "changing port to: %d (%s)\n", idx, desc);
-                        ParseInputDescriptors();
-                        ControllerPortUpdate(i, idx);
+                        changed_port = i;
+                        changed_device = idx;
                      }
                      Widgets::Tooltip(_("core_current_port_current_device_desc"));
 
+                     input_state_t state = input_state[i];
                      for (unsigned j = 0; j < MAX_IDS; j++)
                      {
                         if (!string_is_empty(input_descriptors[i][j].description))
                         {
                            ImGui::PushButtonRepeat(true);
-                           input_state[i].buttons &= ~(1 << j);
+                           state.buttons &= ~(1 << j);
                            if (ImGui::Button(input_descriptors[i][j].description, ImVec2(240, 0)))
-                              input_state[i].buttons |= 1 << 1 * j;
+                              state.buttons |= 1 << 1 * j;
                            ImGui::PopButtonRepeat();
                         }
                      }
                      ImGui::Columns(1);
-                     piccolo->set_input_state(i, input_state[i]);
+                     SetInputState(i, state);
 
                      ImGui::Columns(1);
                   }
                }
+               lock.unlock();
+               if (changed_port >= 0)
+               {
+                  ControllerPortUpdate(changed_port, changed_device);
+                  ParseInputDescriptors();
+               }
                ImGui::Unindent();
             }
             if (ImGui::CollapsingHeader(_("core_current_info_label"), ImGuiTreeNodeFlags_None))
@@ -322,9 +390,101 @@ void Kami::RenderGui(const char* title)
                   ImGui::InputFloat(_("framebuffer_aspect_label"), &aspect, 0, 0, "%.3f", ImGuiInputTextFlags_ReadOnly);
                   Widgets::Tooltip(_("framebuffer_aspect_desc"));
                }
+               if (ImGui::CollapsingHeader(_("core_current_info_audio_label"), ImGuiTreeNodeFlags_None))
+               {
+                  int fill = audio_ring->GetSize();
+                  int underruns = audio_ring->GetUnderruns();
+                  int overruns = audio_ring->GetOverruns();
+
+                  ImGui::InputInt(_("audio_buffer_fill_label"), &fill, 0, 0, ImGuiInputTextFlags_ReadOnly);
+                  Widgets::Tooltip(_("audio_buffer_fill_desc"));
+                  ImGui::InputInt(_("audio_underruns_label"), &underruns, 0, 0, ImGuiInputTextFlags_ReadOnly);
+                  Widgets::Tooltip(_("audio_underruns_desc"));
+                  ImGui::InputInt(_("audio_overruns_label"), &overruns, 0, 0, ImGuiInputTextFlags_ReadOnly);
+                  Widgets::Tooltip(_("audio_overruns_desc"));
+
+                  int target = rate_control.GetTarget();
+                  float average = rate_control.GetFill();
+                  float adjust = rate_control.GetAdjust();
+                  float drift = rate_control.GetDrift();
+                  int saturated = rate_control.GetSaturated();
+
+                  ImGui::InputInt(_("audio_buffer_target_label"), &target, 0, 0, ImGuiInputTextFlags_ReadOnly);
+                  Widgets::Tooltip(_("audio_buffer_target_desc"));
+                  ImGui::InputFloat(
+                     _("audio_buffer_average_label"), &average, 0, 0, "%.1f", ImGuiInputTextFlags_ReadOnly);
+                  Widgets::Tooltip(_("audio_buffer_average_desc"));
+                  ImGui::InputFloat(_("audio_rate_adjust_label"), &adjust, 0, 0, "%.5f", ImGuiInputTextFlags_ReadOnly);
+                  Widgets::Tooltip(_("audio_rate_adjust_desc"));
+                  ImGui::InputFloat(_("audio_rate_drift_label"), &drift, 0, 0, "%.0f", ImGuiInputTextFlags_ReadOnly);
+                  Widgets::Tooltip(_("audio_rate_drift_desc"));
+                  ImGui::InputInt(_("audio_rate_saturated_label"), &saturated, 0, 0, ImGuiInputTextFlags_ReadOnly);
+                  Widgets::Tooltip(_("audio_rate_saturated_desc"));
+               }
+               if (ImGui::CollapsingHeader(_("core_current_info_timing_label"), ImGuiTreeNodeFlags_None))
+               {
+                  double fps = core_info->av_info.timing.fps > 0 ? core_info->av_info.timing.fps : 60.0;
+                  float budget = 1000.0 / fps;
+                  float average = frame_time.load(std::memory_order_relaxed);
+                  float peak = frame_time_max.load(std::memory_order_relaxed);
+                  float speculative = runahead_time.load(std::memory_order_relaxed);
+                  int over_budget = frames_over_budget.load(std::memory_order_relaxed);
+                  float speed = GetFastForward() ? fastforward_speed.load(std::memory_order_relaxed) : 1.0f;
+
+                  ImGui::InputFloat(_("frame_budget_label"), &budget, 0, 0, "%.3f", ImGuiInputTextFlags_ReadOnly);
+                  Widgets::Tooltip(_("frame_budget_desc"));
+                  ImGui::InputFloat(_("frame_time_label"), &average, 0, 0, "%.3f", ImGuiInputTextFlags_ReadOnly);
+                  Widgets::Tooltip(_("frame_time_desc"));
+                  ImGui::InputFloat(_("frame_time_max_label"), &peak, 0, 0, "%.3f", ImGuiInputTextFlags_ReadOnly);
+                  Widgets::Tooltip(_("frame_time_max_desc"));
+                  ImGui::InputFloat(_("runahead_time_label"), &speculative, 0, 0, "%.3f", ImGuiInputTextFlags_ReadOnly);
+                  Widgets::Tooltip(_("runahead_time_desc"));
+                  ImGui::InputInt(_("frames_over_budget_label"), &over_budget, 0, 0, ImGuiInputTextFlags_ReadOnly);
+                  Widgets::Tooltip(_("frames_over_budget_desc"));
+                  ImGui::InputFloat(_("fastforward_speed_label"), &speed, 0, 0, "%.1f", ImGuiInputTextFlags_ReadOnly);
+                  Widgets::Tooltip(_("fastforward_speed_desc"));
+
+                  if (input_threaded.load(std::memory_order_relaxed))
+                  {
+                     float age = input_age.load(std::memory_order_relaxed);
+                     float age_max = input_age_max.load(std::memory_order_relaxed);
+
+                     ImGui::InputFloat(_("input_age_label"), &age, 0, 0, "%.3f", ImGuiInputTextFlags_ReadOnly);
+                     Widgets::Tooltip(_("input_age_desc"));
+                     ImGui::InputFloat(_("input_age_max_label"), &age_max, 0, 0, "%.3f", ImGuiInputTextFlags_ReadOnly);
+                     Widgets::Tooltip(_("input_age_max_desc"));
+                  }
+
+                  if (threaded)
+                     Widgets::PacerStats(&pacer);
+               }
+               if (ImGui::CollapsingHeader(_("core_current_info_rewind_label"), ImGuiTreeNodeFlags_None))
+               {
+                  double fps = core_info->av_info.timing.fps > 0 ? core_info->av_info.timing.fps : 60.0;
+                  int snapshots = rewind.GetCount();
+                  float used = rewind.GetUsed() / (1024.0f * 1024.0f);
+                  float seconds = snapshots * rewind_granularity.load(std::memory_order_relaxed) / fps;
+                  float ratio = rewind.GetCompressionRatio();
+
+                  ImGui::InputInt(_("rewind_snapshots_label"), &snapshots, 0, 0, ImGuiInputTextFlags_ReadOnly);
+                  Widgets::Tooltip(_("rewind_snapshots_desc"));
+                  ImGui::InputFloat(_("rewind_used_label"), &used, 0, 0, "%.2f", ImGuiInputTextFlags_ReadOnly);
+                  Widgets::Tooltip(_("rewind_used_desc"));
+                  ImGui::InputFloat(_("rewind_seconds_label"), &seconds, 0, 0, "%.1f", ImGuiInputTextFlags_ReadOnly);
+                  Widgets::Tooltip(_("rewind_seconds_desc"));
+                  ImGui::InputFloat(_("rewind_ratio_label"), &ratio, 0, 0, "%.1f", ImGuiInputTextFlags_ReadOnly);
+                  Widgets::Tooltip(_("rewind_ratio_desc"));
+               }
                ImGui::Unindent();
                ImGui::EndChild();
             }
+            // the options belong to the core as well, a change is applied once they are released
+            std::unique_lock<std::mutex> lock = LockCore();
+            size_t option_count = piccolo->get_option_count();
+            core_option_t* options = piccolo->get_options();
+            int changed_option = -1;
+            int changed_value = 0;
+
             if (option_count > 0 && ImGui::CollapsingHeader(_("core_current_options_label"), ImGuiTreeNodeFlags_None))
             {
                ImGuiWindowFlags window_flags = 0;
@@ -333,20 +493,21 @@ void Kami::RenderGui(const char* title)
                for (unsigned i = 0; i < option_count; i++)
                {
                   core_option_t* option = &options[i];
-                  char* description = option->description;
-                  struct string_list* values = OptionGetValues(option);
+                  int index = option->value;
 
-                  int index = OptionGetIndex(option, values);
                   ImGui::PushItemWidth(ImGui::GetWindowWidth() * 0.30f);
-                  if (Widgets::StringListCombo(description, &index, values, 0))
+                  if (ImGui::Combo(option->description, &index, option->values, option->value_count, 0))
                   {
-                     char* value = values->elems[index].data;
-                     OptionUpdate(option, value);
+                     changed_option = i;
+                     changed_value = index;
                   }
                   ImGui::PopItemWidth();
                }
                ImGui::EndChild();
             }
+            lock.unlock();
+            if (changed_option >= 0)
+               OptionUpdate(changed_option, changed_value);
          }
          break;
          default:
@@ -368,15 +529,15 @@ void Kami::RenderGui(const char* title)
    {
       if (core_count > 0)
       {
-         ImGui::Combo(_("core_selector_label"), &current_core, core_entries, core_count);
+         ImGui::Combo(_("core_selector_label"), &current_core, catalog->GetNames(), core_count);
 
-         if (previous_core == -1)
+         if (previous_core == -1 && !job_running)
          {
-            core_info = &core_info_list[0];
-
-            core_loaded = piccolo->peek_core(core_info->file_name);
+            JobStart(catalog->GetEntry(current_core)->file_name, NULL, true);
             previous_core = current_core;
          }
+         if (job_running)
+            RenderJobProgress();
       }
       else
       {
@@ -388,7 +549,8 @@ void Kami::RenderGui(const char* title)
    {
       if (ImGui::BeginPopupModal(_("window_title_file_selector"), NULL, ImGuiWindowFlags_AlwaysAutoResize))
       {
-         static file_list_t* list = NULL;
+         static file_list_t list = {};
+         static bool listed = false;
          static int index = 0;
 
          static char cur[PATH_MAX_LENGTH];
@@ -398,22 +560,24 @@ void Kami::RenderGui(const char* title)
 
          ImGui::Text(_("file_selector_label"));
 
-         if (!list)
+         if (!listed)
          {
             strlcpy(cur, dir, sizeof(cur));
+            strlcpy(old, dir, sizeof(old));
             logger(LOG_DEBUG, tag, "path: %s\n", cur);
-            list = (file_list_t*)calloc(1, sizeof(file_list_t));
-            get_file_list(cur, list, "", true);
+            get_file_list(cur, &list, "", true);
+            listed = true;
          }
          else
          {
-            if (Widgets::FileList("", &index, list, 10))
+            if (Widgets::FileList("", &index, &list, 10))
             {
-               fill_pathname_join(cur, old, list->file_names[index], sizeof(cur));
-               if (path_is_directory(cur))
+               fill_pathname_join(cur, old, file_list_get_name(&list, index), sizeof(cur));
+               if (file_list_is_directory(&list, index))
                {
-                  get_file_list(cur, list, "", true);
+                  get_file_list(cur, &list, "", true);
                   strlcpy(old, cur, sizeof(old));
+                  index = 0;
                }
             }
          }
@@ -4,6 +4,7 @@
 #include "imgui_impl_sdl.h"
 
 #include "input/gamepad.h"
+#include "input/remap.h"
 #include "kami.h"
 #include "widgets.h"
 
@@ -14,6 +15,11 @@ static const char* asset_dir = "./assets/icons/gamepad/generic";
 
 static bool quit = false;
 
+// paces the main loop when it is not held by vsync
+static FramePacer loop_pacer;
+// samples the gamepad between frames when enabled
+static InputThread input_thread;
+
 std::vector<Kami*> kami_instances;
 Kami* current_kami_instance;
 
@@ -23,6 +29,8 @@ ImGuiIO io;
 std::vector<Asset> gamepad_assets;
 
 GamePad* controller;
+// bindings of every port, compiled whenever they change
+static InputRemap input_remap;
 
 const char* device_gamepad_asset_names[] = {
    "base.png",         "b.png",     "y.png",  "select.png", "start.png",       "up.png",          "down.png",
@@ -117,35 +125,24 @@ void set_default_style()
    clearColor = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 }
 
-struct gamepad_lut
+// feeds every connected gamepad through its port's bindings
+bool gamepad_input_source(unsigned port, input_state_t* state)
 {
-   int libretro_id;
-   int sdl_id;
-};
+   if (!controller || !controller->IsConnected(port))
+      return false;
 
-struct gamepad_lut lut[] = {
-   {GAMEPAD_B, SDL_CONTROLLER_BUTTON_A},
-   {GAMEPAD_Y, SDL_CONTROLLER_BUTTON_X},
-   {GAMEPAD_SELECT, SDL_CONTROLLER_BUTTON_BACK},
-   {GAMEPAD_START, SDL_CONTROLLER_BUTTON_START},
-   {GAMEPAD_UP, SDL_CONTROLLER_BUTTON_DPAD_UP},
-   {GAMEPAD_DOWN, SDL_CONTROLLER_BUTTON_DPAD_DOWN},
-   {GAMEPAD_LEFT, SDL_CONTROLLER_BUTTON_DPAD_LEFT},
-   {GAMEPAD_RIGHT, SDL_CONTROLLER_BUTTON_DPAD_RIGHT},
-   {GAMEPAD_A, SDL_CONTROLLER_BUTTON_B},
-   {GAMEPAD_X, SDL_CONTROLLER_BUTTON_Y},
-   {GAMEPAD_L, SDL_CONTROLLER_BUTTON_LEFTSHOULDER},
-   {GAMEPAD_R, SDL_CONTROLLER_BUTTON_RIGHTSHOULDER},
-   {GAMEPAD_L2, SDL_CONTROLLER_AXIS_TRIGGERLEFT},
-   {GAMEPAD_R2, SDL_CONTROLLER_AXIS_TRIGGERRIGHT},
-   {GAMEPAD_L3, SDL_CONTROLLER_BUTTON_LEFTSTICK},
-   {GAMEPAD_R3, SDL_CONTROLLER_BUTTON_RIGHTSTICK},
-   {GAMEPAD_GUIDE, SDL_CONTROLLER_BUTTON_GUIDE},
-   {GAMEPAD_LEFT_STICK_X, SDL_CONTROLLER_AXIS_LEFTX},
-   {GAMEPAD_LEFT_STICK_Y, SDL_CONTROLLER_AXIS_LEFTY},
-   {GAMEPAD_RIGHT_STICK_X, SDL_CONTROLLER_AXIS_RIGHTX},
-   {GAMEPAD_RIGHT_STICK_Y, SDL_CONTROLLER_AXIS_RIGHTY},
-};
+   gamepad_state_t pad = controller->GetState(port);
+   memset(state, 0, sizeof(*state));
+   input_remap.Apply(port, &pad, state);
+
+   return true;
+}
+
+// the input thread pumps the gamepads before every sample while it runs
+void gamepad_input_pump()
+{
+   controller->Update();
+}
 
 void render_frontend_input_device_state()
 {
@@ -161,20 +158,16 @@ void render_frontend_input_device_state()
    ImVec2 p = ImGui::GetCursorScreenPos();
    ImGui::Image((void*)(intptr_t)base, ImVec2(width, height));
 
-   input_state_t state;
+   // shows the first port as the core sees it, guide is not a joypad button so it comes straight from the pad
+   gamepad_state_t pad = controller->GetState();
+   input_state_t state = {};
+   input_remap.Apply(0, &pad, &state);
+   uint32_t pressed = (uint16_t)state.buttons | ((pad.buttons >> SDL_CONTROLLER_BUTTON_GUIDE) & 1) << GAMEPAD_GUIDE;
 
    for (unsigned i = 0; i <= GAMEPAD_GUIDE; i++)
    {
-      if (i != GAMEPAD_L2 && i != GAMEPAD_R2)
-      {
-         if (controller->GetButtonState((SDL_GameControllerButton)lut[i].sdl_id))
-            asset = gamepad_assets.at(i + 1);
-      }
-      else
-      {
-         if (controller->GetAxisValue((SDL_GameControllerAxis)lut[i].sdl_id))
-            asset = gamepad_assets.at(i + 1);
-      }
+      if ((pressed >> i) & 1)
+         asset = gamepad_assets.at(i + 1);
       result = asset.get_texture();
       ImGui::GetWindowDrawList()->AddImage(
          (void*)(intptr_t)result, p, ImVec2(p.x + width, p.y + height), ImVec2(0, 0), ImVec2(1, 1));
@@ -182,7 +175,7 @@ void render_frontend_input_device_state()
 
    for (unsigned i = GAMEPAD_LEFT_STICK_X; i < GAMEPAD_LAST; i++)
    {
-      if (abs(controller->GetAxisValue((SDL_GameControllerAxis)lut[i].sdl_id)) > 10000)
+      if (abs(state.analogs[i - GAMEPAD_LEFT_STICK_X]) > 10000)
          asset = gamepad_assets.at(i + 1);
       result = asset.get_texture();
       ImGui::GetWindowDrawList()->AddImage(
@@ -200,11 +193,152 @@ bool add_instance()
    ret = new_instance->CoreListInit("./cores");
 
    if (ret)
+   {
+      new_instance->SetThreaded(core_threaded->GetValue());
+      new_instance->SetFrameLimiter(video_frame_limiter->GetValue());
+      new_instance->SetResamplerQuality(audio_resampler_quality->GetValue().m_mode);
+      new_instance->SetRateControl(audio_rate_control->GetValue());
+      new_instance->SetRewind(
+         rewind_enable->GetValue(), rewind_buffer_size->GetValue() * 1024 * 1024, rewind_granularity->GetValue());
+      new_instance->SetRunAhead(runahead_frames->GetValue(), runahead_second_instance->GetValue());
+      new_instance->SetFastForwardRatio(fastforward_ratio->GetValue());
+      new_instance->SetInputPollMode(input_poll_mode->GetValue().m_mode);
+      if (input_thread.IsRunning())
+      {
+         input_thread.Attach(new_instance->GetInputQueue());
+         new_instance->SetInputThreaded(true);
+      }
       kami_instances.push_back(new_instance);
+   }
+   else
+      delete new_instance;
 
    return ret;
 }
 
+void set_threaded_mode()
+{
+   bool threaded = core_threaded->GetValue();
+
+   for (Kami* instance : kami_instances)
+      instance->SetThreaded(threaded);
+}
+
+void set_frame_limiter()
+{
+   bool enabled = video_frame_limiter->GetValue();
+
+   for (Kami* instance : kami_instances)
+      instance->SetFrameLimiter(enabled);
+}
+
+// rate the main loop runs at, zero when nothing holds it back
+double get_loop_rate()
+{
+   // vsync holds the loop to the display, trust the measured rate once it settled
+   if (video_vsync->GetValue())
+   {
+      double measured = loop_pacer.GetRate();
+      return measured > 0 ? measured : get_display_refresh_rate();
+   }
+
+   if (!video_frame_limiter->GetValue())
+      return 0;
+
+   // otherwise the loop follows the fastest core that runs on it
+   double rate = 0;
+   for (Kami* instance : kami_instances)
+   {
+      if (instance->GetCoreStatus() != CORE_STATUS_RUNNING)
+         continue;
+      rate = MAX(rate, instance->GetCoreInfo()->av_info.timing.fps);
+   }
+
+   return rate > 0 ? rate : 60.0;
+}
+
+void set_resampler_quality()
+{
+   unsigned quality = audio_resampler_quality->GetValue().m_mode;
+
+   for (Kami* instance : kami_instances)
+      instance->SetResamplerQuality(quality);
+}
+
+void set_rate_control()
+{
+   bool enabled = audio_rate_control->GetValue();
+
+   for (Kami* instance : kami_instances)
+      instance->SetRateControl(enabled);
+}
+
+void set_rewind()
+{
+   bool enabled = rewind_enable->GetValue();
+   unsigned capacity = rewind_buffer_size->GetValue() * 1024 * 1024;
+   unsigned granularity = rewind_granularity->GetValue();
+
+   for (Kami* instance : kami_instances)
+      instance->SetRewind(enabled, capacity, granularity);
+}
+
+void set_runahead()
+{
+   unsigned frames = runahead_frames->GetValue();
+   bool second_instance = runahead_second_instance->GetValue();
+
+   for (Kami* instance : kami_instances)
+      instance->SetRunAhead(frames, second_instance);
+}
+
+void set_fastforward_ratio()
+{
+   unsigned ratio = fastforward_ratio->GetValue();
+
+   for (Kami* instance : kami_instances)
+      instance->SetFastForwardRatio(ratio);
+}
+
+void set_input_poll_mode()
+{
+   unsigned mode = input_poll_mode->GetValue().m_mode;
+
+   for (Kami* instance : kami_instances)
+      instance->SetInputPollMode(mode);
+}
+
+void set_input_remap()
+{
+   for (unsigned port = 0; port < MAX_PORTS; port++)
+   {
+      remap_config_t config = *input_remap.GetConfig(port);
+
+      config.turbo_rate = input_turbo_rate->GetValue();
+      config.threshold = input_axis_threshold->GetValue() * 0x7fff / 100;
+      input_remap.SetConfig(port, &config);
+   }
+}
+
+void set_input_thread()
+{
+   input_thread.Stop();
+   for (Kami* instance : kami_instances)
+   {
+      instance->SetInputThreaded(false);
+      input_thread.Detach(instance->GetInputQueue());
+   }
+   if (!input_thread_enable->GetValue())
+      return;
+
+   // queues are attached before the instances read from them so no change is missed
+   for (Kami* instance : kami_instances)
+      input_thread.Attach(instance->GetInputQueue());
+   input_thread.Start(gamepad_input_source, gamepad_input_pump, input_thread_rate->GetValue());
+   for (Kami* instance : kami_instances)
+      instance->SetInputThreaded(true);
+}
+
 void invader()
 {
    int instance_count = kami_instances.size();
@@ -225,18 +359,59 @@ void invader()
    if (instance_count > 1 && ImGui::SliderInt(_("kami_instance_selector"), &current_instance, 1, instance_count))
       current_kami_instance = kami_instances.at(current_instance - 1);
 
-   if (!controller)
-   {
-      controller = new GamePad();
-      controller->Initialize();
-   }
-   controller->Update();
    render_frontend_input_device_state();
 
    video_fullscreen->Render();
    video_fullscreen_windowed->Render();
    video_vsync->Render();
+   video_frame_limiter->Render();
    video_scale_mode->Render();
+   core_threaded->Render();
+   audio_resampler_quality->Render();
+   audio_rate_control->Render();
+   rewind_enable->Render();
+   rewind_buffer_size->Render();
+   rewind_granularity->Render();
+   runahead_frames->Render();
+   runahead_second_instance->Render();
+   fastforward_ratio->Render();
+   input_poll_mode->Render();
+   input_thread_enable->Render();
+   input_thread_rate->Render();
+   input_turbo_rate->Render();
+   input_axis_threshold->Render();
+
+   if (controller && ImGui::CollapsingHeader(_("input_devices_label"), ImGuiTreeNodeFlags_None))
+   {
+      if (controller->GetCount() == 0)
+         ImGui::Text(_("input_devices_none_label"));
+      for (unsigned port = 0; port < MAX_PORTS; port++)
+      {
+         if (!controller->IsConnected(port))
+            continue;
+         ImGui::Text(_("input_devices_port_label"), port + 1, controller->GetName(port).c_str());
+         ImGui::PushID(port);
+         Widgets::RemapEditor(&input_remap, port);
+         ImGui::PopID();
+      }
+   }
+   if (ImGui::CollapsingHeader(_("pacing_label"), ImGuiTreeNodeFlags_None))
+      Widgets::PacerStats(&loop_pacer);
+   if (input_thread.IsRunning() && ImGui::CollapsingHeader(_("input_thread_label"), ImGuiTreeNodeFlags_None))
+   {
+      float rate = input_thread.GetRate();
+      int events = (int)input_thread.GetEvents();
+      int coalesced = (int)input_thread.GetCoalesced();
+
+      ImGui::InputFloat(_("input_thread_measured_rate_label"), &rate, 0, 0, "%.0f", ImGuiInputTextFlags_ReadOnly);
+      Widgets::Tooltip(_("input_thread_measured_rate_desc"));
+      ImGui::InputInt(_("input_thread_events_label"), &events, 0, 0, ImGuiInputTextFlags_ReadOnly);
+      Widgets::Tooltip(_("input_thread_events_desc"));
+      ImGui::InputInt(_("input_thread_coalesced_label"), &coalesced, 0, 0, ImGuiInputTextFlags_ReadOnly);
+      Widgets::Tooltip(_("input_thread_coalesced_desc"));
+   }
+   if (ImGui::CollapsingHeader(_("instances_label"), ImGuiTreeNodeFlags_None))
+      Widgets::PoolStats(PiccoloPool::get());
 
    ImGui::End();
 }
@@ -259,12 +434,21 @@ void imgui_setup()
    io.Fonts->AddFontDefault();
 }
 
+// takes the next event except for controller buttons and axes, those are left for GamePad::Update. Taking them here
+// too would let two threads apply a press and its release in either order
+static bool gui_poll_event(SDL_Event* e)
+{
+   return SDL_PeepEvents(e, 1, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_CONTROLLERAXISMOTION - 1) > 0
+      || SDL_PeepEvents(e, 1, SDL_GETEVENT, SDL_CONTROLLERBUTTONUP + 1, SDL_LASTEVENT) > 0;
+}
+
 void imgui_draw_frame()
 {
    unsigned i = 0;
    SDL_Event e;
 
-   while (SDL_PollEvent(&e) != 0)
+   SDL_PumpEvents();
+   while (gui_poll_event(&e))
    {
       if (controller)
          controller->ReceiveEvent(e);
@@ -304,6 +488,21 @@ int main(int argc, char* argv[])
 
    init_localization();
    common_config_load();
+   core_threaded->SetEventCallback(set_threaded_mode);
+   video_frame_limiter->SetEventCallback(set_frame_limiter);
+   audio_resampler_quality->SetEventCallback(set_resampler_quality);
+   audio_rate_control->SetEventCallback(set_rate_control);
+   rewind_enable->SetEventCallback(set_rewind);
+   rewind_buffer_size->SetEventCallback(set_rewind);
+   rewind_granularity->SetEventCallback(set_rewind);
+   runahead_frames->SetEventCallback(set_runahead);
+   runahead_second_instance->SetEventCallback(set_runahead);
+   fastforward_ratio->SetEventCallback(set_fastforward_ratio);
+   input_poll_mode->SetEventCallback(set_input_poll_mode);
+   input_thread_enable->SetEventCallback(set_input_thread);
+   input_thread_rate->SetEventCallback(set_input_thread);
+   input_turbo_rate->SetEventCallback(set_input_remap);
+   input_axis_threshold->SetEventCallback(set_input_remap);
 
    if (!create_window(app_name, WINDOW_WIDTH, WINDOW_HEIGHT))
       goto shutdown;
@@ -323,6 +522,11 @@ int main(int argc, char* argv[])
       goto shutdown;
 
    texture_list_init(asset_dir);
+   controller = new GamePad();
+   controller->Initialize();
+   set_input_remap();
+   Kami::SetInputSource(gamepad_input_source);
+   set_input_thread();
    /*
       if (add_instance())
          current_kami_instance = kami_instances.at(0);
@@ -332,12 +536,18 @@ int main(int argc, char* argv[])
    SDL_GL_MakeCurrent(invader_window, invader_context);
    while (!quit)
    {
+      double loop_rate = get_loop_rate();
+
+      // the gamepads are pumped here unless the input thread does it, early polling reads what this publishes
+      if (!input_thread.IsRunning())
+         controller->Update();
+
       for (Kami* instance : kami_instances)
       {
          std::string title = "Core ";
          title += std::to_string(i + 1);
 
-         instance->Main();
+         instance->Main(loop_rate);
          i++;
       }
 
@@ -349,11 +559,34 @@ int main(int argc, char* argv[])
          render_framebuffer(current_kami_instance->GetTextureData(), current_kami_instance->GetCoreInfo());
       imgui_draw_frame();
       SDL_GL_SwapWindow(invader_window);
+
+      // with vsync the swap already waited for the display, only measure it
+      if (video_vsync->GetValue())
+      {
+         loop_pacer.SetRate(0);
+         loop_pacer.Mark();
+      }
+      else
+      {
+         loop_pacer.SetRate(loop_rate);
+         loop_pacer.Wait();
+      }
    }
 
 shutdown:
    logger(LOG_DEBUG, tag, "shutting down\n");
-   // delete kami;
+   // stops the core worker threads before the window and context go away, the input thread before the queues it feeds
+   input_thread.Stop();
+   for (Kami* instance : kami_instances)
+      delete instance;
+   kami_instances.clear();
+   if (controller)
+   {
+      controller->Release();
+      delete controller;
+      controller = NULL;
+   }
+   destroy_audio_device();
 
    imgui_shutdown();
    destroy_window();
@@ -13,27 +13,48 @@ bool Setting<bool>::Render()
    bool ret = ImGui::Checkbox(_(label.c_str()), &m_value);
    Widgets::Tooltip(_(desc.c_str()));
 
-   if (ret)
+   if (ret && setting_event)
       setting_event();
 
    return ret;
 }
 
-bool Setting<scale_mode_t>::Render()
+template <>
+bool Setting<int>::Render()
 {
    std::string label = m_name + "_label";
    std::string desc = m_name + "_desc";
 
-   char** entries = (char**)calloc(SCALE_MODE_LAST, sizeof(scale_mode_t*));
-   for (unsigned i = 0; i < SCALE_MODE_LAST; i++)
-   {
-      std::string entry = scale_modes[i].m_name + "_label";
-      char* cstr = &entry[0];
-      entries[i] = _(cstr);
-   }
+   ImGui::SliderInt(_(label.c_str()), &m_value, m_min, m_max);
+   // sliders change on every step of a drag, only report the value once it settled
+   bool ret = ImGui::IsItemDeactivatedAfterEdit();
+   Widgets::Tooltip(_(desc.c_str()));
+
+   if (ret && setting_event)
+      setting_event();
 
-   bool ret = ImGui::Combo(_(label.c_str()), &m_value.m_mode, entries, SCALE_MODE_LAST);
+   return ret;
+}
+
+bool Setting<setting_mode_t>::Render()
+{
+   std::string label = m_name + "_label";
+   std::string desc = m_name + "_desc";
+
+   std::vector<const char*> entries(m_count);
+   for (unsigned i = 0; i < m_count; i++)
+      entries[i] = _(m_labels[i].c_str());
+
+   int mode = m_value.m_mode;
+   bool ret = ImGui::Combo(_(label.c_str()), &mode, entries.data(), m_count);
    Widgets::Tooltip(_(desc.c_str()));
 
+   if (ret)
+   {
+      m_value = m_modes[mode];
+      if (setting_event)
+         setting_event();
+   }
+
    return ret;
-}
\ No newline at end of file
+}
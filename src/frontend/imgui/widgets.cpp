@@ -45,25 +45,26 @@ bool StringListCombo(const char* label, int* current_item, struct string_list* l
    return ret;
 }
 
+// names are read straight from the list's pool, nothing is copied per frame
+static bool FileListGetter(void* data, int index, const char** out_text)
+{
+   *out_text = file_list_get_name((const file_list_t*)data, index);
+   return true;
+}
+
 // TODO: replace paths with std::filesystem
 // file list widget
 bool FileList(const char* label, int* current_item, file_list_t* list, int popup_max_height_in_items)
 {
    bool ret = false;
-   char** entries = (char**)calloc(list->file_count, sizeof(char*));
-   for (unsigned i = 0; i < list->file_count; i++)
-   {
-      entries[i] = list->file_names[i];
-   }
 
    ImGui::PushItemWidth(-FLT_MIN);
-   if (ImGui::ListBox(label, current_item, entries, list->file_count, popup_max_height_in_items))
+   if (ImGui::ListBox(label, current_item, FileListGetter, list, list->file_count, popup_max_height_in_items))
       ret = true;
    else
       ret = false;
    ImGui::PopItemWidth();
 
-   free(entries);
    return ret;
 }
 
@@ -82,4 +83,85 @@ void Tooltip(const char* desc)
    }
 }
 
+// frame pacer statistics widget
+void PacerStats(const FramePacer* pacer)
+{
+   float jitter = pacer->GetJitter();
+   float jitter_max = pacer->GetJitterMax();
+   int late = (int)pacer->GetLate();
+   float rate = pacer->GetRate();
+
+   ImGui::InputFloat(_("pacing_rate_label"), &rate, 0, 0, "%.3f", ImGuiInputTextFlags_ReadOnly);
+   Widgets::Tooltip(_("pacing_rate_desc"));
+   ImGui::InputFloat(_("pacing_jitter_label"), &jitter, 0, 0, "%.1f", ImGuiInputTextFlags_ReadOnly);
+   Widgets::Tooltip(_("pacing_jitter_desc"));
+   ImGui::InputFloat(_("pacing_jitter_max_label"), &jitter_max, 0, 0, "%.1f", ImGuiInputTextFlags_ReadOnly);
+   Widgets::Tooltip(_("pacing_jitter_max_desc"));
+   ImGui::InputInt(_("pacing_late_label"), &late, 0, 0, ImGuiInputTextFlags_ReadOnly);
+   Widgets::Tooltip(_("pacing_late_desc"));
+}
+
+void PoolStats(PiccoloPool* pool)
+{
+   int active = (int)pool->get_active_count();
+   int idle = (int)pool->get_idle_count();
+   int created = (int)pool->get_created_count();
+   int recycled = (int)pool->get_recycled_count();
+   float memory = pool->get_memory_usage() / 1024.0f;
+
+   ImGui::InputInt(_("instances_active_label"), &active, 0, 0, ImGuiInputTextFlags_ReadOnly);
+   Widgets::Tooltip(_("instances_active_desc"));
+   ImGui::InputInt(_("instances_idle_label"), &idle, 0, 0, ImGuiInputTextFlags_ReadOnly);
+   Widgets::Tooltip(_("instances_idle_desc"));
+   ImGui::InputInt(_("instances_created_label"), &created, 0, 0, ImGuiInputTextFlags_ReadOnly);
+   Widgets::Tooltip(_("instances_created_desc"));
+   ImGui::InputInt(_("instances_recycled_label"), &recycled, 0, 0, ImGuiInputTextFlags_ReadOnly);
+   Widgets::Tooltip(_("instances_recycled_desc"));
+   ImGui::InputFloat(_("instances_memory_label"), &memory, 0, 0, "%.1f", ImGuiInputTextFlags_ReadOnly);
+   Widgets::Tooltip(_("instances_memory_desc"));
+}
+
+bool RemapEditor(InputRemap* remap, unsigned port)
+{
+   static std::vector<const char*> sources;
+   remap_config_t config = *remap->GetConfig(port);
+   bool changed = false;
+
+   if (sources.empty())
+   {
+      for (unsigned i = 0; i < remap_source_count(); i++)
+         sources.push_back(remap_source_name(i));
+   }
+
+   ImGui::Columns(2, NULL, false);
+   for (unsigned button = 0; button < REMAP_BUTTONS; button++)
+   {
+      remap_binding_t* binding = &config.buttons[button];
+      int source = remap_binding_source(binding);
+      bool turbo = binding->turbo;
+
+      ImGui::PushID(button);
+      if (ImGui::Combo(remap_button_name(button), &source, sources.data(), sources.size()))
+      {
+         *binding = remap_source_binding(source);
+         binding->turbo = turbo;
+         changed = true;
+      }
+      ImGui::NextColumn();
+      if (ImGui::Checkbox(_("input_remap_turbo_label"), &turbo))
+      {
+         binding->turbo = turbo;
+         changed = true;
+      }
+      Widgets::Tooltip(_("input_remap_turbo_desc"));
+      ImGui::NextColumn();
+      ImGui::PopID();
+   }
+   ImGui::Columns(1);
+
+   if (changed)
+      remap->SetConfig(port, &config);
+   return changed;
+}
+
 }  // namespace Widgets
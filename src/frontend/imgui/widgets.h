@@ -2,6 +2,7 @@
 #define WIDGET_H_
 
 #include "common.h"
+#include "input/remap.h"
 #include "kami.h"
 
 // generic widgets
@@ -9,6 +10,9 @@ namespace Widgets
 {
 
 void Tooltip(const char* desc);
+void PacerStats(const FramePacer* pacer);
+void PoolStats(PiccoloPool* pool);
+bool RemapEditor(InputRemap* remap, unsigned port);
 bool FileList(const char* label, int* current_item, file_list_t* list, int popup_max_height_in_items);
 bool StringListCombo(const char* label, int* current_item, struct string_list* list, int popup_max_height_in_items);
 bool ControllerTypesCombo(
@@ -2,15 +2,19 @@
 
 static const char* tag = "[input]";
 
+// events taken from the queue at once by Update
+#define GAMEPAD_EVENT_BATCH 64
+
 GamePad::GamePad()
 {
    // initialize variables
-   gamepad = NULL;
-   gamepad_id = -1;
-
-   // set button and axis states to zero
-   memset(button_state, 0, sizeof(Uint8) * SDL_CONTROLLER_BUTTON_MAX);
-   memset(axis_values, 0, sizeof(float) * SDL_CONTROLLER_AXIS_MAX);
+   for (unsigned port = 0; port < MAX_PORTS; port++)
+   {
+      devices[port].controller = NULL;
+      devices[port].id = -1;
+      devices[port].state = gamepad_state_t();
+   }
+   connected = 0;
 }
 
 bool GamePad::Initialize(void)
@@ -25,71 +29,191 @@ bool GamePad::Initialize(void)
    else
       logger(LOG_INFO, tag, "database loaded succesfully\n");
 
-   SDL_GameControllerEventState(SDL_IGNORE);
+   SDL_GameControllerEventState(SDL_ENABLE);
+   // the event loop leaves the controllers alone, Update is the only place they are pumped
+   SDL_SetHint(SDL_HINT_AUTO_UPDATE_JOYSTICKS, "0");
+
+   // pick up the pads attached before the events were enabled
+   std::lock_guard<std::mutex> guard(lock);
+   for (int index = 0; index < SDL_NumJoysticks(); index++)
+   {
+      if (SDL_IsGameController(index))
+         Open(index);
+   }
    return true;
 }
 
 void GamePad::Update(void)
 {
-   // early return if no gamepad attached
-   if (gamepad == NULL)
-      return;
+   SDL_Event events[GAMEPAD_EVENT_BATCH];
+   int count;
 
-   // update controller info from SDL
+   // update controller info from SDL, changes are queued as events. This also detects attached pads, so it runs even
+   // when none is connected
    SDL_GameControllerUpdate();
 
-   // update button states
-   for (int b = 0; b < SDL_CONTROLLER_BUTTON_MAX; ++b)
-      button_state[b] = SDL_GameControllerGetButton(gamepad, (SDL_GameControllerButton)b);
+   std::lock_guard<std::mutex> guard(lock);
 
-   // update axis values
-   for (int a = 0; a < SDL_CONTROLLER_AXIS_MAX; ++a)
+   // attach and detach events are left for the gui thread, it is the one that may open devices. Nothing else takes
+   // button and axis events, those of pads without a port are dropped so they don't pile up
+   do
    {
-      axis_values[a] = SDL_GameControllerGetAxis(gamepad, (SDL_GameControllerAxis)a);
-   }
+      count = SDL_PeepEvents(
+         events, GAMEPAD_EVENT_BATCH, SDL_GETEVENT, SDL_CONTROLLERAXISMOTION, SDL_CONTROLLERBUTTONUP);
+      for (int i = 0; i < count; i++)
+         Apply(events[i]);
+   } while (count == GAMEPAD_EVENT_BATCH);
+}
+
+void GamePad::Release(void)
+{
+   std::lock_guard<std::mutex> guard(lock);
+
+   for (unsigned port = 0; port < MAX_PORTS; port++)
+      Close(port);
 }
 
 void GamePad::ReceiveEvent(const SDL_Event& oEvent)
 {
+   std::lock_guard<std::mutex> guard(lock);
+   int port;
+
+   // only attach and detach arrive here, buttons and axes are applied by Update alone
    switch (oEvent.type)
    {
-      // controller attached event
+      // controller attached event, which is the device index
       case SDL_CONTROLLERDEVICEADDED:
-      {
-         // for now only support the first attached gamepad
-         if (gamepad == NULL)
-         {
-            // open the controller
-            gamepad_id = oEvent.cdevice.which;
-            gamepad = SDL_GameControllerOpen(gamepad_id);
-
-            // set button and axis states to zero
-            memset(button_state, 0, sizeof(Uint8) * SDL_CONTROLLER_BUTTON_MAX);
-            memset(axis_values, 0, sizeof(float) * SDL_CONTROLLER_AXIS_MAX);
-            logger(LOG_INFO, tag, "device added %d\n", gamepad);
-         }
+         Open(oEvent.cdevice.which);
          break;
-      }
-      // controller removed event
+      // controller removed event, which is the instance id
       case SDL_CONTROLLERDEVICEREMOVED:
-      {
-         // only remove if it was the same gamepad
-         if (gamepad_id = oEvent.cdevice.which)
-         {
-            gamepad_id = -1;
-            gamepad = NULL;
-         }
+         port = FindPort(oEvent.cdevice.which);
+         if (port >= 0)
+            Close(port);
+         break;
+   }
+}
+
+unsigned GamePad::GetCount() const
+{
+   return __builtin_popcount(connected.load(std::memory_order_relaxed));
+}
+
+std::string GamePad::GetName(unsigned port)
+{
+   std::lock_guard<std::mutex> guard(lock);
+
+   return devices[port].name;
+}
+
+bool GamePad::GetButtonState(const SDL_GameControllerButton button, unsigned port) const
+{
+   return (states[port].Load().buttons >> button) & 1;
+}
+
+float GamePad::GetAxisValue(const SDL_GameControllerAxis axis, unsigned port) const
+{
+   return states[port].Load().axes[axis];
+}
+
+void GamePad::Apply(const SDL_Event& oEvent)
+{
+   int port;
+
+   switch (oEvent.type)
+   {
+      case SDL_CONTROLLERBUTTONDOWN:
+      case SDL_CONTROLLERBUTTONUP:
+         port = FindPort(oEvent.cbutton.which);
+         if (port < 0 || oEvent.cbutton.button >= SDL_CONTROLLER_BUTTON_MAX)
+            break;
+         if (oEvent.cbutton.state == SDL_PRESSED)
+            devices[port].state.buttons |= 1u << oEvent.cbutton.button;
+         else
+            devices[port].state.buttons &= ~(1u << oEvent.cbutton.button);
+         states[port].Store(devices[port].state);
+         break;
+      case SDL_CONTROLLERAXISMOTION:
+         port = FindPort(oEvent.caxis.which);
+         if (port < 0 || oEvent.caxis.axis >= SDL_CONTROLLER_AXIS_MAX)
+            break;
+         devices[port].state.axes[oEvent.caxis.axis] = oEvent.caxis.value;
+         states[port].Store(devices[port].state);
          break;
-      }
    }
 }
 
-bool GamePad::GetButtonState(const SDL_GameControllerButton button) const
+int GamePad::FindPort(SDL_JoystickID id) const
 {
-   return (button_state[button] == 1);
+   uint32_t mask = connected.load(std::memory_order_relaxed);
+
+   for (unsigned port = 0; port < MAX_PORTS; port++)
+   {
+      if ((mask >> port) & 1 && devices[port].id == id)
+         return port;
+   }
+   return -1;
 }
 
-float GamePad::GetAxisValue(const SDL_GameControllerAxis axis) const
+void GamePad::Open(int index)
 {
-   return axis_values[axis];
+   uint32_t mask = connected.load(std::memory_order_relaxed);
+   unsigned port;
+
+   // the pads found by Initialize are announced again once events are enabled
+   if (FindPort(SDL_JoystickGetDeviceInstanceID(index)) >= 0)
+      return;
+   for (port = 0; port < MAX_PORTS; port++)
+   {
+      if (!((mask >> port) & 1))
+         break;
+   }
+   if (port == MAX_PORTS)
+   {
+      logger(LOG_WARN, tag, "no free port for device %d\n", index);
+      return;
+   }
+
+   gamepad_device_t* device = &devices[port];
+   device->controller = SDL_GameControllerOpen(index);
+   if (!device->controller)
+   {
+      logger(LOG_ERROR, tag, "error opening device %d: %s\n", index, SDL_GetError());
+      return;
+   }
+   device->id = SDL_JoystickInstanceID(SDL_GameControllerGetJoystick(device->controller));
+   device->name = SDL_GameControllerName(device->controller) ? SDL_GameControllerName(device->controller) : "";
+
+   // start from the current state, only the changes arrive as events
+   device->state = gamepad_state_t();
+   for (int b = 0; b < SDL_CONTROLLER_BUTTON_MAX; ++b)
+   {
+      if (SDL_GameControllerGetButton(device->controller, (SDL_GameControllerButton)b))
+         device->state.buttons |= 1u << b;
+   }
+   for (int a = 0; a < SDL_CONTROLLER_AXIS_MAX; ++a)
+      device->state.axes[a] = SDL_GameControllerGetAxis(device->controller, (SDL_GameControllerAxis)a);
+   states[port].Store(device->state);
+   connected.store(mask | 1u << port, std::memory_order_release);
+
+   logger(LOG_INFO, tag, "device %s added to port %u\n", device->name.c_str(), port + 1);
+}
+
+void GamePad::Close(unsigned port)
+{
+   uint32_t mask = connected.load(std::memory_order_relaxed);
+   gamepad_device_t* device = &devices[port];
+
+   if (!((mask >> port) & 1))
+      return;
+
+   connected.store(mask & ~(1u << port), std::memory_order_release);
+   SDL_GameControllerClose(device->controller);
+   logger(LOG_INFO, tag, "device %s removed from port %u\n", device->name.c_str(), port + 1);
+
+   device->controller = NULL;
+   device->id = -1;
+   device->name.clear();
+   device->state = gamepad_state_t();
+   states[port].Store(device->state);
 }
@@ -1,8 +1,35 @@
 #ifndef INPUT_H_
 #define INPUT_H_
 
+// system
+#include <atomic>
+#include <mutex>
+#include <string>
+
 #include "common.h"
+#include "seqlock.h"
+
+// state of one pad, one bit per SDL_GameControllerButton and the raw axis values
+typedef struct gamepad_state
+{
+   uint32_t buttons;
+   int16_t axes[SDL_CONTROLLER_AXIS_MAX];
+} gamepad_state_t;
+
+// an open SDL game controller and the port it feeds
+typedef struct gamepad_device
+{
+   SDL_GameController* controller;
+   SDL_JoystickID id;
+   std::string name;
+   // changed by events under the lock, published to readers after every change
+   gamepad_state_t state;
+} gamepad_device_t;
 
+// gamepad tracks every attached SDL game controller and assigns each one to the lowest free port. State is updated
+// from controller events as they arrive instead of reading every button and axis, so the cost follows the activity
+// and not the number of pads. The controllers are pumped from a single thread, the input thread while it runs and the
+// gui otherwise, everyone else reads the latest published state of a port without waiting on it
 class GamePad
 {
 public:
@@ -11,26 +38,42 @@ public:
 
    // control flow functions
    bool Initialize(void);
+   // pump the controllers and apply the pending button and axis events, only ever called from the one pumping thread
    void Update(void);
    void Release(void);
 
-   // sdl event handling
+   // sdl event handling, the gui hands over attach and detach events
    void ReceiveEvent(const SDL_Event& oEvent);
 
+   // port assignment
+   bool IsConnected(unsigned port) const { return (connected.load(std::memory_order_acquire) >> port) & 1; }
+   unsigned GetCount() const;
+   std::string GetName(unsigned port);
+
+   // latest published state of a port, zeroed when no pad feeds it
+   gamepad_state_t GetState(unsigned port = 0) const { return states[port].Load(); }
+
    // button state
-   bool GetButtonState(const SDL_GameControllerButton button) const;
+   bool GetButtonState(const SDL_GameControllerButton button, unsigned port = 0) const;
 
    // axis state
-   float GetAxisValue(const SDL_GameControllerAxis axis) const;
+   float GetAxisValue(const SDL_GameControllerAxis axis, unsigned port = 0) const;
 
 private:
    // internal variables
-   SDL_GameController* gamepad;
-   int gamepad_id;
+   gamepad_device_t devices[MAX_PORTS];
+   // one bit per port with a pad on it
+   std::atomic<uint32_t> connected;
+
+   // internal state, the lock keeps device changes from the gui apart from the pumping thread
+   std::mutex lock;
+   SeqLock<gamepad_state_t> states[MAX_PORTS];
 
-   // internal state
-   unsigned button_state[SDL_CONTROLLER_BUTTON_MAX];
-   float axis_values[SDL_CONTROLLER_AXIS_MAX];
+   // these expect the lock to be held, Apply takes button and axis events
+   void Apply(const SDL_Event& oEvent);
+   int FindPort(SDL_JoystickID id) const;
+   void Open(int index);
+   void Close(unsigned port);
 };
 
-#endif
\ No newline at end of file
+#endif
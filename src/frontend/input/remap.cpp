@@ -0,0 +1,221 @@
+// system
+#include <string>
+#include <thread>
+
+#include "input_thread.h"
+#include "remap.h"
+
+static const char* tag = "[input]";
+
+// digital buttons by position, triggers feed l2 / r2
+static const remap_binding_t default_buttons[REMAP_BUTTONS] = {
+   {REMAP_SOURCE_BUTTON, SDL_CONTROLLER_BUTTON_A, false},
+   {REMAP_SOURCE_BUTTON, SDL_CONTROLLER_BUTTON_X, false},
+   {REMAP_SOURCE_BUTTON, SDL_CONTROLLER_BUTTON_BACK, false},
+   {REMAP_SOURCE_BUTTON, SDL_CONTROLLER_BUTTON_START, false},
+   {REMAP_SOURCE_BUTTON, SDL_CONTROLLER_BUTTON_DPAD_UP, false},
+   {REMAP_SOURCE_BUTTON, SDL_CONTROLLER_BUTTON_DPAD_DOWN, false},
+   {REMAP_SOURCE_BUTTON, SDL_CONTROLLER_BUTTON_DPAD_LEFT, false},
+   {REMAP_SOURCE_BUTTON, SDL_CONTROLLER_BUTTON_DPAD_RIGHT, false},
+   {REMAP_SOURCE_BUTTON, SDL_CONTROLLER_BUTTON_B, false},
+   {REMAP_SOURCE_BUTTON, SDL_CONTROLLER_BUTTON_Y, false},
+   {REMAP_SOURCE_BUTTON, SDL_CONTROLLER_BUTTON_LEFTSHOULDER, false},
+   {REMAP_SOURCE_BUTTON, SDL_CONTROLLER_BUTTON_RIGHTSHOULDER, false},
+   {REMAP_SOURCE_AXIS_POSITIVE, SDL_CONTROLLER_AXIS_TRIGGERLEFT, false},
+   {REMAP_SOURCE_AXIS_POSITIVE, SDL_CONTROLLER_AXIS_TRIGGERRIGHT, false},
+   {REMAP_SOURCE_BUTTON, SDL_CONTROLLER_BUTTON_LEFTSTICK, false},
+   {REMAP_SOURCE_BUTTON, SDL_CONTROLLER_BUTTON_RIGHTSTICK, false},
+};
+
+static const char* button_names[REMAP_BUTTONS] = {
+   "B", "Y", "Select", "Start", "Up", "Down", "Left", "Right", "A", "X", "L", "R", "L2", "R2", "L3", "R3",
+};
+
+// names of every binding source, built on first use
+static std::vector<std::string> source_names;
+
+void remap_config_default(remap_config_t* config)
+{
+   for (unsigned i = 0; i < REMAP_BUTTONS; i++)
+      config->buttons[i] = default_buttons[i];
+   config->analogs[0] = SDL_CONTROLLER_AXIS_LEFTX;
+   config->analogs[1] = SDL_CONTROLLER_AXIS_LEFTY;
+   config->analogs[2] = SDL_CONTROLLER_AXIS_RIGHTX;
+   config->analogs[3] = SDL_CONTROLLER_AXIS_RIGHTY;
+   config->threshold = 8000;
+   config->turbo_rate = 10;
+}
+
+unsigned remap_source_count()
+{
+   return 1 + SDL_CONTROLLER_BUTTON_MAX + SDL_CONTROLLER_AXIS_MAX * 2;
+}
+
+const char* remap_source_name(unsigned source)
+{
+   if (source_names.empty())
+   {
+      source_names.push_back("-");
+      for (int b = 0; b < SDL_CONTROLLER_BUTTON_MAX; b++)
+         source_names.push_back(SDL_GameControllerGetStringForButton((SDL_GameControllerButton)b));
+      for (int a = 0; a < SDL_CONTROLLER_AXIS_MAX; a++)
+      {
+         std::string axis = SDL_GameControllerGetStringForAxis((SDL_GameControllerAxis)a);
+         source_names.push_back(axis + "+");
+         source_names.push_back(axis + "-");
+      }
+   }
+   return source < source_names.size() ? source_names[source].c_str() : "";
+}
+
+remap_binding_t remap_source_binding(unsigned source)
+{
+   remap_binding_t binding = {REMAP_SOURCE_NONE, 0, false};
+
+   if (source == 0 || source >= remap_source_count())
+      return binding;
+   source--;
+   if (source < SDL_CONTROLLER_BUTTON_MAX)
+   {
+      binding.type = REMAP_SOURCE_BUTTON;
+      binding.index = source;
+      return binding;
+   }
+   source -= SDL_CONTROLLER_BUTTON_MAX;
+   binding.type = source & 1 ? REMAP_SOURCE_AXIS_NEGATIVE : REMAP_SOURCE_AXIS_POSITIVE;
+   binding.index = source / 2;
+   return binding;
+}
+
+unsigned remap_binding_source(const remap_binding_t* binding)
+{
+   switch (binding->type)
+   {
+      case REMAP_SOURCE_BUTTON:
+         return 1 + binding->index;
+      case REMAP_SOURCE_AXIS_POSITIVE:
+         return 1 + SDL_CONTROLLER_BUTTON_MAX + binding->index * 2;
+      case REMAP_SOURCE_AXIS_NEGATIVE:
+         return 1 + SDL_CONTROLLER_BUTTON_MAX + binding->index * 2 + 1;
+   }
+   return 0;
+}
+
+const char* remap_button_name(unsigned button)
+{
+   return button < REMAP_BUTTONS ? button_names[button] : "";
+}
+
+InputRemap::InputRemap()
+{
+   remap_config_t config;
+
+   remap_config_default(&config);
+   for (unsigned port = 0; port < MAX_PORTS; port++)
+   {
+      configs[port] = config;
+      Compile(&config, &tables[port][0]);
+      current[port] = 0;
+      readers[port][0] = 0;
+      readers[port][1] = 0;
+   }
+}
+
+void InputRemap::SetConfig(unsigned port, const remap_config_t* config)
+{
+   unsigned spare = current[port].load() ^ 1;
+
+   if (memcmp(config, &configs[port], sizeof(*config)) == 0)
+      return;
+
+   // an Apply that pinned the spare table before the last swap is about to notice and let go of it
+   while (readers[port][spare].load() != 0)
+      std::this_thread::yield();
+
+   remap_table_t* table = &tables[port][spare];
+   configs[port] = *config;
+   Compile(config, table);
+   current[port].store(spare);
+   logger(
+      LOG_DEBUG, tag, "port %u remapped, %u axis bindings, turbo mask %04x\n", port + 1, table->axis_count,
+      table->turbo_mask);
+}
+
+void InputRemap::Compile(const remap_config_t* config, remap_table_t* table)
+{
+   memset(table, 0, sizeof(*table));
+   for (unsigned button = 0; button < REMAP_BUTTONS; button++)
+   {
+      const remap_binding_t* binding = &config->buttons[button];
+      uint16_t mask = 1 << button;
+
+      if (binding->type == REMAP_SOURCE_NONE)
+         continue;
+      if (binding->turbo)
+         table->turbo_mask |= mask;
+      if (binding->type == REMAP_SOURCE_BUTTON)
+      {
+         // every value of the byte holding the source bit carries the button
+         if (binding->index >= SDL_CONTROLLER_BUTTON_MAX)
+            continue;
+         unsigned byte = binding->index / 8;
+         unsigned bit = binding->index % 8;
+         for (unsigned value = 0; value < 256; value++)
+         {
+            if ((value >> bit) & 1)
+               table->buttons[byte][value] |= mask;
+         }
+      }
+      else if (binding->index < SDL_CONTROLLER_AXIS_MAX)
+      {
+         remap_axis_t* axis = &table->axes[table->axis_count++];
+
+         axis->axis = binding->index;
+         axis->button = button;
+         axis->sign = binding->type == REMAP_SOURCE_AXIS_NEGATIVE ? -1 : 1;
+         axis->threshold = config->threshold;
+      }
+   }
+   for (unsigned i = 0; i < REMAP_ANALOGS; i++)
+      table->analogs[i] = config->analogs[i] < SDL_CONTROLLER_AXIS_MAX ? config->analogs[i] : -1;
+   table->turbo_period = 1000000000LL / (2 * MAX(config->turbo_rate, 1u));
+}
+
+void InputRemap::Apply(unsigned port, const gamepad_state_t* pad, input_state_t* state) const
+{
+   uint32_t source = pad->buttons;
+   uint16_t buttons = 0;
+   unsigned slot;
+
+   // pin the current table, checking it is still current once pinned so SetConfig either waits for this or is done
+   for (;;)
+   {
+      slot = current[port].load();
+      readers[port][slot].fetch_add(1);
+      if (current[port].load() == slot)
+         break;
+      readers[port][slot].fetch_sub(1);
+   }
+   const remap_table_t* table = &tables[port][slot];
+
+   for (unsigned byte = 0; byte < REMAP_BYTES; byte++)
+      buttons |= table->buttons[byte][(source >> (byte * 8)) & 0xff];
+
+   // buttons fed by an axis also get its travel as pressure
+   for (unsigned i = 0; i < table->axis_count; i++)
+   {
+      const remap_axis_t* axis = &table->axes[i];
+      int value = pad->axes[axis->axis] * axis->sign;
+
+      buttons |= (value > axis->threshold) << axis->button;
+      state->analog_buttons[axis->button] = MIN(MAX(value, 0), 0x7fff);
+   }
+
+   for (unsigned i = 0; i < REMAP_ANALOGS; i++)
+      state->analogs[i] = table->analogs[i] >= 0 ? pad->axes[table->analogs[i]] : 0;
+
+   if (buttons & table->turbo_mask && (input_time_now() / table->turbo_period) & 1)
+      buttons &= ~table->turbo_mask;
+   state->buttons = buttons;
+   readers[port][slot].fetch_sub(1);
+}
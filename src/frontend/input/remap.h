@@ -0,0 +1,102 @@
+#ifndef REMAP_H_
+#define REMAP_H_
+
+// system
+#include <atomic>
+
+#include "gamepad.h"
+
+// joypad buttons a core can read, one bit each in input_state_t
+#define REMAP_BUTTONS 16
+#define REMAP_ANALOGS 4
+// bytes of the SDL button mask, each one is looked up in its own table
+#define REMAP_BYTES ((SDL_CONTROLLER_BUTTON_MAX + 7) / 8)
+
+enum remap_source_enum
+{
+   REMAP_SOURCE_NONE = 0,
+   REMAP_SOURCE_BUTTON,
+   REMAP_SOURCE_AXIS_POSITIVE,
+   REMAP_SOURCE_AXIS_NEGATIVE
+};
+
+// what feeds a joypad button, index is an SDL_GameControllerButton or SDL_GameControllerAxis depending on the type
+typedef struct remap_binding
+{
+   uint8_t type;
+   uint8_t index;
+   bool turbo;
+} remap_binding_t;
+
+// user bindings of one port
+typedef struct remap_config
+{
+   remap_binding_t buttons[REMAP_BUTTONS];
+   // SDL_GameControllerAxis feeding each analog axis, -1 for none. Same order as input_state_t analogs
+   int8_t analogs[REMAP_ANALOGS];
+   // axis travel past which an axis bound to a button counts as pressed
+   int16_t threshold;
+   // turbo presses per second
+   unsigned turbo_rate;
+} remap_config_t;
+
+// a button fed by an axis, sign folds the direction in so every test is axis * sign > threshold
+typedef struct remap_axis
+{
+   uint8_t axis;
+   uint8_t button;
+   int8_t sign;
+   int16_t threshold;
+} remap_axis_t;
+
+// bindings compiled into what Apply walks, never changed while it is the current table of its port
+typedef struct remap_table
+{
+   // joypad bits for every value of every byte of the SDL button mask
+   uint16_t buttons[REMAP_BYTES][256];
+   remap_axis_t axes[REMAP_BUTTONS];
+   unsigned axis_count;
+   int8_t analogs[REMAP_ANALOGS];
+   // buttons released during the off half of the turbo cycle, and the length of that half in nanoseconds
+   uint16_t turbo_mask;
+   int64_t turbo_period;
+} remap_table_t;
+
+// fill config with the default layout, buttons by position and triggers as l2 / r2
+void remap_config_default(remap_config_t* config);
+
+// binding sources listed in the order the gui offers them, none first
+unsigned remap_source_count();
+const char* remap_source_name(unsigned source);
+remap_binding_t remap_source_binding(unsigned source);
+unsigned remap_binding_source(const remap_binding_t* binding);
+const char* remap_button_name(unsigned button);
+
+// input remap turns the gamepad state of a port into what the core reads. Bindings are compiled into tables whenever
+// they change, applying them is a few table loads per port. Configuration happens on the gui thread, Apply may run on
+// any thread. Every port has two tables, Apply pins the current one while it reads it and SetConfig compiles into the
+// other one once nothing pins it anymore, then makes it current
+class InputRemap
+{
+public:
+   InputRemap();
+
+   // compile and publish the bindings of a port, waits for the threads still applying the table it replaces
+   void SetConfig(unsigned port, const remap_config_t* config);
+   const remap_config_t* GetConfig(unsigned port) const { return &configs[port]; }
+
+   // fill the joypad part of state from pad
+   void Apply(unsigned port, const gamepad_state_t* pad, input_state_t* state) const;
+
+private:
+   remap_config_t configs[MAX_PORTS];
+   remap_table_t tables[MAX_PORTS][2];
+   // table Apply reads for each port
+   std::atomic<unsigned> current[MAX_PORTS];
+   // threads applying each table right now
+   mutable std::atomic<unsigned> readers[MAX_PORTS][2];
+
+   static void Compile(const remap_config_t* config, remap_table_t* table);
+};
+
+#endif
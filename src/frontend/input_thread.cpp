@@ -0,0 +1,116 @@
+// system
+#include <algorithm>
+#include <chrono>
+
+#include "input_thread.h"
+
+static const char* tag = "[input]";
+
+int64_t input_time_now()
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+InputThread::InputThread()
+{
+   running = false;
+   source = NULL;
+   pump = NULL;
+   rate = INPUT_THREAD_RATE;
+   memset(previous, 0, sizeof(previous));
+   samples = 0;
+   events = 0;
+   coalesced = 0;
+   measured_rate = 0;
+}
+
+void InputThread::Start(input_source_t source, input_pump_t pump, unsigned rate)
+{
+   if (thread.joinable() || !source || !pump || rate == 0)
+      return;
+
+   this->source = source;
+   this->pump = pump;
+   this->rate = rate;
+   memset(previous, 0, sizeof(previous));
+   running.store(true, std::memory_order_release);
+   thread = std::thread(&InputThread::Main, this);
+   logger(LOG_INFO, tag, "input thread started at %uHz\n", rate);
+}
+
+void InputThread::Stop()
+{
+   if (!thread.joinable())
+      return;
+
+   running.store(false, std::memory_order_release);
+   thread.join();
+   measured_rate.store(0, std::memory_order_relaxed);
+   logger(LOG_INFO, tag, "input thread stopped\n");
+}
+
+void InputThread::Attach(InputQueue* queue)
+{
+   std::lock_guard<std::mutex> guard(lock);
+
+   if (std::find(queues.begin(), queues.end(), queue) == queues.end())
+      queues.push_back(queue);
+}
+
+void InputThread::Detach(InputQueue* queue)
+{
+   std::lock_guard<std::mutex> guard(lock);
+
+   queues.erase(std::remove(queues.begin(), queues.end(), queue), queues.end());
+}
+
+void InputThread::Main()
+{
+   std::chrono::nanoseconds period(1000000000 / rate);
+   std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+   std::chrono::steady_clock::time_point window = next;
+   unsigned window_samples = 0;
+
+   while (running.load(std::memory_order_acquire))
+   {
+      pump();
+      for (unsigned port = 0; port < MAX_PORTS; port++)
+      {
+         input_event_t event;
+
+         if (!source(port, &event.state))
+            memset(&event.state, 0, sizeof(event.state));
+         if (memcmp(&event.state, &previous[port], sizeof(event.state)) == 0)
+            continue;
+
+         event.port = port;
+         event.time = input_time_now();
+         previous[port] = event.state;
+         events.fetch_add(1, std::memory_order_relaxed);
+
+         std::lock_guard<std::mutex> guard(lock);
+         for (InputQueue* queue : queues)
+         {
+            if (!queue->Push(event))
+               coalesced.fetch_add(1, std::memory_order_relaxed);
+         }
+      }
+      samples.fetch_add(1, std::memory_order_relaxed);
+      window_samples++;
+
+      std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+      if (now - window >= std::chrono::seconds(1))
+      {
+         measured_rate.store(window_samples / std::chrono::duration<double>(now - window).count());
+         window = now;
+         window_samples = 0;
+      }
+
+      // a thread that fell behind picks up from now instead of sampling in a burst to catch up
+      next += period;
+      if (next < now)
+         next = now;
+      std::this_thread::sleep_until(next);
+   }
+}
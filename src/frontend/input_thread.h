@@ -0,0 +1,154 @@
+#ifndef INPUT_THREAD_H_
+#define INPUT_THREAD_H_
+
+// system
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "libretro/piccolo.h"
+#include "seqlock.h"
+#include "spsc_queue.h"
+
+// default sampling rate of the input thread, in Hz
+#define INPUT_THREAD_RATE 1000
+// events an instance can fall behind by before changes are folded into the latest state of their port
+#define INPUT_QUEUE_SIZE 256
+
+// reads the latest published physical input for a port into state without touching the device, so it may be called
+// from any thread. Returns false if no device feeds the port
+typedef bool (*input_source_t)(unsigned port, input_state_t* state);
+// samples the devices and publishes their state, only ever called from one thread at a time
+typedef void (*input_pump_t)(void);
+
+// a change of the physical input of a port
+typedef struct input_event
+{
+   unsigned port;
+   input_state_t state;
+   // steady clock time the change was sampled at, in nanoseconds
+   int64_t time;
+} input_event_t;
+
+// input queue carries the changes for one consumer. A change that finds the queue full is never lost, it is kept as
+// the latest state of its port and handed out once the consumer caught up with the queue. From then on the port's
+// changes are kept that way until the consumer picked the state up
+class InputQueue
+{
+private:
+   SpscQueue<input_event_t> events;
+   // ports with a state in latest, set by the producer and taken by the consumer
+   std::atomic<uint32_t> resync;
+   SeqLock<input_event_t> latest[MAX_PORTS];
+   // states the consumer took and has yet to hand out, and the time of the last change handed out per port
+   uint32_t pending;
+   input_event_t pending_events[MAX_PORTS];
+   int64_t delivered[MAX_PORTS];
+
+public:
+   InputQueue(size_t capacity)
+      : events(capacity)
+   {
+      resync = 0;
+      pending = 0;
+      memset(delivered, 0, sizeof(delivered));
+   }
+
+   // producer side, returns false if the change went to the latest state instead of the queue
+   bool Push(const input_event_t& event)
+   {
+      uint32_t bit = 1u << event.port;
+
+      if (!(resync.load(std::memory_order_acquire) & bit) && events.Push(event))
+         return true;
+      latest[event.port].Store(event);
+      resync.fetch_or(bit, std::memory_order_release);
+      return false;
+   }
+
+   // consumer side, queued changes first, then the latest states of the ports that overflowed. A state can be taken
+   // while older changes of its port are still queued behind a refilled queue, those are skipped by their time so a
+   // port never goes back
+   bool Pop(input_event_t* event)
+   {
+      for (;;)
+      {
+         if (pending)
+         {
+            unsigned port = __builtin_ctz(pending);
+
+            pending &= pending - 1;
+            *event = pending_events[port];
+         }
+         else if (!events.Pop(event))
+         {
+            pending = resync.exchange(0, std::memory_order_acquire);
+            for (unsigned port = 0; port < MAX_PORTS; port++)
+            {
+               if ((pending >> port) & 1)
+                  pending_events[port] = latest[port].Load();
+            }
+            if (!pending)
+               return false;
+            continue;
+         }
+         if (event->time < delivered[event->port])
+            continue;
+         delivered[event->port] = event->time;
+         return true;
+      }
+   }
+};
+
+// steady clock time in nanoseconds, the clock input events are stamped with
+int64_t input_time_now();
+
+// input thread samples every port at a fixed rate, much finer than the display refresh, and pushes the changes it
+// sees, stamped with when they were sampled, to every attached queue. Consumers drain their queue when their core
+// polls so press timing survives all the way into the core
+class InputThread
+{
+private:
+   std::thread thread;
+   std::atomic<bool> running;
+   input_source_t source;
+   input_pump_t pump;
+   unsigned rate;
+
+   // guards the attached queues, the thread only holds it while pushing a change
+   std::mutex lock;
+   std::vector<InputQueue*> queues;
+   // state of every port as of the last sample, only touched by the thread
+   input_state_t previous[MAX_PORTS];
+
+   // statistics
+   std::atomic<uint64_t> samples;
+   std::atomic<uint64_t> events;
+   std::atomic<uint64_t> coalesced;
+   std::atomic<double> measured_rate;
+
+   void Main();
+
+public:
+   InputThread();
+   ~InputThread() { Stop(); }
+
+   // the thread pumps the devices itself before every sample, whoever pumped them before has to stop while it runs
+   void Start(input_source_t source, input_pump_t pump, unsigned rate);
+   void Stop();
+   bool IsRunning() { return thread.joinable(); }
+
+   // queues keep receiving events until they are detached, the caller keeps ownership
+   void Attach(InputQueue* queue);
+   void Detach(InputQueue* queue);
+
+   // sampling rate achieved, in Hz
+   double GetRate() const { return measured_rate.load(std::memory_order_relaxed); }
+   uint64_t GetSamples() const { return samples.load(std::memory_order_relaxed); }
+   uint64_t GetEvents() const { return events.load(std::memory_order_relaxed); }
+   // changes that found a queue full and were folded into the latest state of their port
+   uint64_t GetCoalesced() const { return coalesced.load(std::memory_order_relaxed); }
+};
+
+#endif
@@ -24,6 +24,8 @@ static void localization_strings()
    // video
    _("video_vsync_label");
    _("video_vsync_desc");
+   _("video_frame_limiter_label");
+   _("video_frame_limiter_desc");
    _("video_fullscreen_label");
    _("video_fullscreen_desc");
    _("video_fullscreen_windowed_label");
@@ -36,10 +38,44 @@ static void localization_strings()
    _("audio_enable_desc");
    _("audio_sync_label");
    _("audio_sync_desc");
+   _("audio_resampler_quality_label");
+   _("audio_resampler_quality_desc");
+   _("audio_rate_control_label");
+   _("audio_rate_control_desc");
+
+   // rewind
+   _("rewind_enable_label");
+   _("rewind_enable_desc");
+   _("rewind_buffer_size_label");
+   _("rewind_buffer_size_desc");
+   _("rewind_granularity_label");
+   _("rewind_granularity_desc");
+
+   // run-ahead
+   _("runahead_frames_label");
+   _("runahead_frames_desc");
+   _("runahead_second_instance_label");
+   _("runahead_second_instance_desc");
+   _("fastforward_ratio_label");
+   _("fastforward_ratio_desc");
+
+   // input
+   _("input_poll_mode_label");
+   _("input_poll_mode_desc");
+   _("input_thread_enable_label");
+   _("input_thread_enable_desc");
+   _("input_thread_rate_label");
+   _("input_thread_rate_desc");
+   _("input_turbo_rate_label");
+   _("input_turbo_rate_desc");
+   _("input_axis_threshold_label");
+   _("input_axis_threshold_desc");
 
    // general
    _("log_level_label");
    _("log_level_desc");
+   _("core_threaded_label");
+   _("core_threaded_desc");
 
    // window titles
    _("window_title_settings");
@@ -90,6 +126,12 @@ static void localization_strings()
    _("core_current_info_desc");
    _("core_current_info_video_label");
    _("core_current_info_video_desc");
+   _("core_current_info_audio_label");
+   _("core_current_info_audio_desc");
+   _("core_current_info_timing_label");
+   _("core_current_info_timing_desc");
+   _("core_current_info_rewind_label");
+   _("core_current_info_rewind_desc");
    _("core_current_input_label");
    _("core_current_input_desc");
    _("core_current_port_label");
@@ -98,6 +140,12 @@ static void localization_strings()
    _("core_current_port_current_device_desc")
    _("core_current_reset_core_label");
    _("core_current_reset_core_desc");
+   _("core_current_swap_content_label");
+   _("core_current_swap_content_desc");
+   _("core_current_fastforward_label");
+   _("core_current_fastforward_desc");
+   _("core_current_rewind_label");
+   _("core_current_rewind_desc");
    _("core_current_actions_label");
    _("core_current_actions_desc");
    _("core_current_video_output_label");
@@ -122,10 +170,90 @@ static void localization_strings()
    _("framebuffer_height_desc");
    _("framebuffer_aspect_label");
    _("framebuffer_aspect_desc");
+   _("audio_buffer_fill_label");
+   _("audio_buffer_fill_desc");
+   _("audio_underruns_label");
+   _("audio_underruns_desc");
+   _("audio_overruns_label");
+   _("audio_overruns_desc");
+   _("audio_buffer_target_label");
+   _("audio_buffer_target_desc");
+   _("audio_buffer_average_label");
+   _("audio_buffer_average_desc");
+   _("audio_rate_adjust_label");
+   _("audio_rate_adjust_desc");
+   _("audio_rate_drift_label");
+   _("audio_rate_drift_desc");
+   _("audio_rate_saturated_label");
+   _("audio_rate_saturated_desc");
+   _("frame_budget_label");
+   _("frame_budget_desc");
+   _("frame_time_label");
+   _("frame_time_desc");
+   _("frame_time_max_label");
+   _("frame_time_max_desc");
+   _("runahead_time_label");
+   _("runahead_time_desc");
+   _("frames_over_budget_label");
+   _("frames_over_budget_desc");
+   _("fastforward_speed_label");
+   _("fastforward_speed_desc");
+   _("rewind_snapshots_label");
+   _("rewind_snapshots_desc");
+   _("rewind_used_label");
+   _("rewind_used_desc");
+   _("rewind_seconds_label");
+   _("rewind_seconds_desc");
+   _("rewind_ratio_label");
+   _("rewind_ratio_desc");
+   _("pacing_label");
+   _("pacing_rate_label");
+   _("pacing_rate_desc");
+   _("pacing_jitter_label");
+   _("pacing_jitter_desc");
+   _("pacing_jitter_max_label");
+   _("pacing_jitter_max_desc");
+   _("pacing_late_label");
+   _("pacing_late_desc");
+   _("input_devices_label");
+   _("input_devices_none_label");
+   _("input_devices_port_label");
+   _("input_remap_turbo_label");
+   _("input_remap_turbo_desc");
+   _("input_thread_label");
+   _("input_thread_measured_rate_label");
+   _("input_thread_measured_rate_desc");
+   _("input_thread_events_label");
+   _("input_thread_events_desc");
+   _("input_thread_coalesced_label");
+   _("input_thread_coalesced_desc");
+   _("input_age_label");
+   _("input_age_desc");
+   _("input_age_max_label");
+   _("input_age_max_desc");
+   _("instances_label");
+   _("instances_active_label");
+   _("instances_active_desc");
+   _("instances_idle_label");
+   _("instances_idle_desc");
+   _("instances_created_label");
+   _("instances_created_desc");
+   _("instances_recycled_label");
+   _("instances_recycled_desc");
+   _("instances_memory_label");
+   _("instances_memory_desc");
 
    // long_labels
    _("file_selector_label");
 
+   // core load stages
+   _("core_load_stage_none");
+   _("core_load_stage_library");
+   _("core_load_stage_init");
+   _("core_load_stage_content");
+   _("core_load_stage_game");
+   _("core_load_stage_done");
+
    // scale modes
    _("scale_mode_off_label");
    _("scale_mode_full_label");
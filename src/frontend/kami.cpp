@@ -1,91 +1,635 @@
+// system
+#include <math.h>
+
 #include "kami.h"
 
 static const char* tag = "[invader]";
 
+input_source_t Kami::input_source = NULL;
+
 bool Kami::CoreListInit(const char* path)
 {
-   bool ret = false;
+   catalog = CoreCatalog::Get(path);
+   core_count = (int)catalog->GetCount();
+   logger(LOG_DEBUG, tag, "cores found: %d\n", core_count);
+
+   return core_count > 0;
+}
+
+void Kami::JobStart(const char* core_file, const char* game_file, bool peek)
+{
+   if (job_running)
+      return;
+
+   strlcpy(job_core_file, core_file, sizeof(job_core_file));
+   strlcpy(job_game_file, game_file ? game_file : "", sizeof(job_game_file));
+   job_peek = peek;
+   job_swap = false;
+   job_info_valid = false;
+   for (size_t i = 0; peek && catalog && i < catalog->GetCount(); i++)
+   {
+      const core_catalog_entry_t* entry = catalog->GetEntry(i);
+
+      if (!string_is_equal(entry->file_name, core_file))
+         continue;
+      strlcpy(job_info.core_name, entry->core_name, sizeof(job_info.core_name));
+      strlcpy(job_info.core_version, entry->core_version, sizeof(job_info.core_version));
+      strlcpy(job_info.extensions, entry->extensions, sizeof(job_info.extensions));
+      job_info.supports_no_game = entry->supports_no_game;
+      job_info.block_extract = entry->block_extract;
+      job_info.full_path = entry->full_path;
+      job_info_valid = true;
+      break;
+   }
+   job_result = false;
+   job_done = false;
+   job_running = true;
+
+   // callbacks are set up here so the gui thread can follow the job's progress on an instance that already exists
+   job_piccolo = new PiccoloWrapper();
+   job_piccolo->set_callbacks(InputPoll, this);
+   job_piccolo->set_audio_callback(kami_render_audio, this);
+
+   logger(LOG_DEBUG, tag, "%s %s in the background\n", peek ? "peeking" : "loading", core_file);
+   job = std::thread(&Kami::JobMain, this);
+}
+
+void Kami::JobMain()
+{
+   const char* game_file = string_is_empty(job_game_file) ? NULL : job_game_file;
+
+   if (job_swap)
+   {
+      std::lock_guard<std::mutex> lock(core_lock);
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+      job_result = job_piccolo->swap_game(game_file);
+      job_swap_time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+   }
+   else if (job_peek && job_info_valid)
+      job_result = job_piccolo->peek_info(job_core_file, &job_info);
+   else
+      job_result = job_piccolo->load_game(job_core_file, game_file, frontend_supports_bitmasks, job_peek);
+   job_done.store(true, std::memory_order_release);
+}
+
+bool Kami::JobUpdate()
+{
+   if (!job_running)
+      return false;
+   if (!job_done.load(std::memory_order_acquire))
+      return true;
+
+   job.join();
+   job_running = false;
+
+   // the instance stays in place, only the content changed
+   if (job_swap)
+   {
+      if (job_result)
+         logger(LOG_INFO, tag, "swapped content to %s in %.2fms\n", job_game_file, job_swap_time);
+      else
+         logger(LOG_ERROR, tag, "failed swapping content to %s\n", job_game_file);
+      job_swap = false;
+      job_piccolo = NULL;
+      return false;
+   }
+
+   if (!job_result)
+   {
+      logger(LOG_ERROR, tag, "failed %s %s\n", job_peek ? "peeking" : "loading", job_core_file);
+      delete job_piccolo;
+      job_piccolo = NULL;
+      return false;
+   }
+
+   // nothing runs the previous instance at this point, it is only replaced
+   StopWorker();
+   {
+      std::lock_guard<std::mutex> lock(core_lock);
+      delete piccolo;
+      piccolo = job_piccolo;
+      job_piccolo = NULL;
+      ContentReset();
+   }
+
+   core_loaded = true;
+   core_info = piccolo->get_info();
+   logger(LOG_INFO, tag, "%s %s\n", job_peek ? "peeked" : "loaded", job_core_file);
+   return false;
+}
+
+void Kami::ContentReset()
+{
+   // the second instance and the rewind history belong to the previous content, even when the state size matches
+   StopShadow();
+   shadow_failed = false;
+   if (rewind.IsReady())
+      rewind.Deinit();
+   frame_accumulator = 0;
+
+   // the core starts over from not fast-forwarding, RunFrame tells it again once frames are skipped
+   fastforwarding = false;
+   piccolo->set_fastforwarding(false);
+   fastforward_speed.store(1.0, std::memory_order_relaxed);
+}
+
+void Kami::OptionUpdate(unsigned index, unsigned value)
+{
+   std::lock_guard<std::mutex> lock(core_lock);
+
+   // the core may have set other options since the gui listed them
+   if (index >= piccolo->get_option_count())
+      return;
+   core_option_t* option = &piccolo->get_options()[index];
+   if (value >= option->value_count)
+      return;
+   logger(LOG_INFO, tag, "changing option %s to %s\n", option->description, option->values[value]);
+   piccolo->set_option_value(index, value);
+
+   core_option_t* shadow_option = shadow ? shadow->find_option(option->key) : NULL;
+   if (shadow_option)
+      shadow->set_option_value(shadow_option - shadow->get_options(), value);
+}
+
+void Kami::ControllerPortUpdate(int port, int device)
+{
+   std::lock_guard<std::mutex> lock(core_lock);
+   piccolo->set_controller_port_device(port, device);
+   if (shadow)
+      shadow->set_controller_port_device(port, device);
+}
+
+void Kami::SetInputState(int port, input_state_t state)
+{
+   std::lock_guard<std::mutex> lock(input_lock);
+   input_state[port] = state;
+}
+
+void Kami::SwapContent(const char* game_file)
+{
+   if (job_running || !piccolo)
+      return;
+
+   // the worker can't be left running frames on a core that may end up without content, Main runs none until the
+   // job finished
+   StopWorker();
+   {
+      std::lock_guard<std::mutex> lock(core_lock);
+      ContentReset();
+   }
+
+   strlcpy(job_core_file, core_info->file_name, sizeof(job_core_file));
+   strlcpy(job_game_file, game_file, sizeof(job_game_file));
+   job_peek = false;
+   job_swap = true;
+   job_result = false;
+   job_done = false;
+   job_running = true;
+   job_piccolo = piccolo;
+
+   logger(LOG_DEBUG, tag, "swapping content to %s in the background\n", game_file);
+   job = std::thread(&Kami::JobMain, this);
+}
+
+void Kami::AudioUpdate(bool producing)
+{
+   if (producing && !audio_registered)
+      audio_registered = audio_register_source(audio_ring);
+   else if (!producing && audio_registered)
+   {
+      audio_unregister_source(audio_ring);
+      audio_registered = false;
+   }
+}
+
+void Kami::InputDrain(bool measure)
+{
+   int64_t now = input_time_now();
+   input_event_t event;
+
+   while (input_queue.Pop(&event))
+   {
+      double age = (now - event.time) / 1000000.0;
+      double previous = input_age.load(std::memory_order_relaxed);
+
+      input_physical[event.port] = event.state;
+      if (!measure)
+         continue;
+      input_age.store(previous + (age - previous) / 16, std::memory_order_relaxed);
+      if (age > input_age_max.load(std::memory_order_relaxed))
+         input_age_max.store(age, std::memory_order_relaxed);
+   }
+}
+
+void Kami::InputLatch()
+{
+   input_state_t physical[MAX_PORTS];
+
+   // the input thread feeds the queue instead, it is drained when the frame starts
+   if (
+      input_poll_mode.load(std::memory_order_relaxed) != INPUT_POLL_EARLY
+      || input_threaded.load(std::memory_order_relaxed))
+      return;
+
+   for (unsigned port = 0; port < MAX_PORTS; port++)
+   {
+      if (!input_source || !input_source(port, &physical[port]))
+         memset(&physical[port], 0, sizeof(physical[port]));
+   }
+   std::lock_guard<std::mutex> lock(input_lock);
+   memcpy(input_early, physical, sizeof(input_early));
+}
 
-   char buf[PATH_MAX_LENGTH];
-   bool peeked = false;
-   file_list_t* core_list = (file_list_t*)calloc(1, sizeof(file_list_t));
-#ifdef _WIN32
-   get_file_list(path, core_list, ".dll", false);
-#else
-   get_file_list(path, core_list, ".so", false);
-#endif
+void Kami::InputMerge(input_state_t* state, const input_state_t* latched)
+{
+   bool threaded_input = input_threaded.load(std::memory_order_relaxed);
 
-   piccolo = new PiccoloWrapper();
-   logger(LOG_DEBUG, tag, "core count: %d\n", core_list->file_count);
+   if (threaded_input)
+      InputDrain(true);
 
-   if (core_list->file_count > 0)
+   for (unsigned port = 0; port < MAX_PORTS; port++)
    {
-      for (unsigned i = 0; i < core_list->file_count; i++)
+      input_state_t physical;
+
+      state[port] = input_frame[port];
+      if (threaded_input)
+         physical = input_physical[port];
+      else if (latched)
+         physical = latched[port];
+      else if (!input_source || !input_source(port, &physical))
+         continue;
+
+      state[port].buttons |= physical.buttons;
+      for (unsigned i = 0; i < 4; i++)
       {
-         snprintf(buf, sizeof(buf), "%s/%s", path, core_list->file_names[i]);
-         peeked = piccolo->peek_core(buf);
-         if (peeked)
-         {
-            core_info_t* info = piccolo->get_info();
-
-            strlcpy(core_info_list[i].file_name, info->file_name, sizeof(core_info_list[i].file_name));
-            strlcpy(core_info_list[i].core_name, info->core_name, sizeof(core_info_list[i].core_name));
-            strlcpy(core_info_list[i].core_version, info->core_version, sizeof(core_info_list[i].core_version));
-            strlcpy(core_info_list[i].extensions, info->extensions, sizeof(core_info_list[i].extensions));
-            core_info_list[i].supports_no_game = info->supports_no_game;
-            core_info_list[i].block_extract = info->block_extract;
-            core_info_list[i].full_path = info->full_path;
-
-            logger(LOG_DEBUG, tag, "file name: %s\n", core_info_list[i].file_name);
-            logger(LOG_DEBUG, tag, "core name: %s\n", core_info_list[i].core_name);
-            logger(LOG_DEBUG, tag, "core version: %s\n", core_info_list[i].core_version);
-            logger(LOG_DEBUG, tag, "valid extensions: %s\n", core_info_list[i].extensions);
-            core_count++;
-         }
-         piccolo->unload_core();
+         if (physical.analogs[i])
+            state[port].analogs[i] = physical.analogs[i];
       }
+      for (unsigned i = 0; i < 16; i++)
+         state[port].analog_buttons[i] = MAX(state[port].analog_buttons[i], physical.analog_buttons[i]);
+   }
+}
+
+void Kami::InputPoll(input_state_t* state, unsigned ports, void* user)
+{
+   Kami* kami = (Kami*)user;
+
+   // the other modes set the input before the frame started
+   if (kami->input_poll_mode.load(std::memory_order_relaxed) == INPUT_POLL_LATE && ports == MAX_PORTS)
+      kami->InputMerge(state, NULL);
+}
+
+void Kami::Reset()
+{
+   std::lock_guard<std::mutex> lock(core_lock);
+   piccolo->core_reset();
+}
+
+core_frame_buffer_t* Kami::RunFrame()
+{
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+   bool rewind_ready = RewindUpdate();
+
+   // step back one snapshot and run a single frame from it so there is something to show, its audio is dropped.
+   // Right after the history was reset there is nothing to restore yet, the frame runs as usual
+   if (rewind_ready && rewinding.load(std::memory_order_relaxed) && rewind.HasState())
+   {
+      rewind.Pop(rewind_state);
+      piccolo->core_unserialize(rewind_state, rewind_state_size);
+      audio_muted = true;
+      piccolo->core_run();
+      audio_muted = false;
+      rewind_counter = 0;
+      return piccolo->get_video_data();
+   }
+
+   unsigned runahead = RunAheadUpdate();
+   bool skipping = fastforward.load(std::memory_order_relaxed);
 
-      logger(LOG_DEBUG, tag, "cores found: %d\n", core_count);
-      for (unsigned i = 0; i < core_count; i++)
+   if (skipping != fastforwarding)
+   {
+      fastforwarding = skipping;
+      piccolo->set_fastforwarding(skipping);
+      if (shadow)
+         shadow->set_fastforwarding(skipping);
+      fastforward_speed.store(1.0, std::memory_order_relaxed);
+      logger(LOG_DEBUG, tag, "fast-forward %s\n", skipping ? "on" : "off");
+   }
+   // there is nothing to gain from predicting input while skipping frames
+   if (skipping)
+      runahead = 0;
+
+   input_state_t early[MAX_PORTS];
+   {
+      std::lock_guard<std::mutex> lock(input_lock);
+      memcpy(input_frame, input_state, sizeof(input_frame));
+      memcpy(early, input_early, sizeof(early));
+   }
+   // late polling leaves it to the core's own poll
+   unsigned poll_mode = input_poll_mode.load(std::memory_order_relaxed);
+   if (poll_mode != INPUT_POLL_LATE)
+   {
+      input_state_t state[MAX_PORTS];
+
+      InputMerge(state, poll_mode == INPUT_POLL_EARLY ? early : NULL);
+      for (unsigned i = 0; i < MAX_PORTS; i++)
       {
-         core_entries[i] = core_info_list[i].core_name;
-         logger(LOG_DEBUG, tag, "loading file %s\n", core_entries[i]);
+         piccolo->set_input_state(i, state[i]);
+         if (shadow)
+            shadow->set_input_state(i, state[i]);
       }
+   }
+   if (skipping)
+   {
+      double previous = fastforward_speed.load(std::memory_order_relaxed);
+      unsigned skipped = FastForward(start);
 
-      ret = true;
+      fastforward_speed.store(previous + (skipped + 1 - previous) / 16, std::memory_order_relaxed);
+   }
+   piccolo->core_run();
+
+   // the ring is sampled once the frame's audio is in, the new ratio applies to the next frame
+   if (resampler.IsReady())
+      resampler.SetAdjust(
+         rate_control_enabled.load(std::memory_order_relaxed) ? rate_control.Update(audio_ring->GetSize()) : 1.0);
+
+   if (rewind_ready && ++rewind_counter >= rewind_granularity.load(std::memory_order_relaxed))
+   {
+      rewind_counter = 0;
+      if (piccolo->core_serialize(rewind_state, rewind_state_size))
+         rewind.Push(rewind_state);
+   }
+
+   core_frame_buffer_t* frame = piccolo->get_video_data();
+   if (runahead)
+   {
+      std::chrono::steady_clock::time_point speculative = std::chrono::steady_clock::now();
+      double previous = runahead_time.load(std::memory_order_relaxed);
+      double ms;
+
+      frame = RunAhead(runahead);
+      ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - speculative).count();
+      runahead_time.store(previous + (ms - previous) / 16, std::memory_order_relaxed);
+   }
+
+   double fps = core_info->av_info.timing.fps > 0 ? core_info->av_info.timing.fps : 60.0;
+   double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+   double previous = frame_time.load(std::memory_order_relaxed);
+
+   frame_time.store(previous + (ms - previous) / 16, std::memory_order_relaxed);
+   if (ms > frame_time_max.load(std::memory_order_relaxed))
+      frame_time_max.store(ms, std::memory_order_relaxed);
+   if (ms > 1000.0 / fps && !skipping)
+      frames_over_budget.fetch_add(1, std::memory_order_relaxed);
+
+   return frame;
+}
+
+unsigned Kami::FastForward(std::chrono::steady_clock::time_point start)
+{
+   unsigned ratio = fastforward_ratio.load(std::memory_order_relaxed);
+   double fps = core_info->av_info.timing.fps > 0 ? core_info->av_info.timing.fps : 60.0;
+   double budget = KAMI_FASTFORWARD_BUDGET / fps;
+   unsigned skipped = 0;
+
+   // only the last frame is shown, the skipped ones leave no trace in the audio ring or the rewind history
+   audio_muted = true;
+   while (ratio ? skipped + 1 < ratio
+                : std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < budget)
+   {
+      piccolo->core_run();
+      skipped++;
+   }
+   audio_muted = false;
+
+   return skipped;
+}
+
+unsigned Kami::RunAheadUpdate()
+{
+   unsigned frames = runahead_frames.load(std::memory_order_relaxed);
+   bool second_instance = runahead_second_instance.load(std::memory_order_relaxed);
+
+   if (frames == 0 || !second_instance)
+   {
+      StopShadow();
+      shadow_failed = false;
+   }
+   if (frames == 0)
+      return 0;
+
+   // run-ahead restores the state every frame, cores without savestate support can't do it
+   size_t state_size = piccolo->core_serialize_size();
+   if (state_size == 0)
+      return 0;
+
+   if (state_size > runahead_state_size)
+   {
+      void* state = realloc(runahead_state, state_size);
+      if (!state)
+      {
+         logger(LOG_ERROR, tag, "failed to allocate %u bytes for savestates\n", (unsigned)state_size);
+         return 0;
+      }
+      runahead_state = state;
+   }
+   runahead_state_size = state_size;
+
+   if (second_instance && !shadow && !shadow_failed && !StartShadow())
+   {
+      logger(LOG_WARN, tag, "second instance unavailable, running ahead on the main instance\n");
+      shadow_failed = true;
+   }
+
+   return frames;
+}
+
+core_frame_buffer_t* Kami::RunAhead(unsigned frames)
+{
+   if (!piccolo->core_serialize(runahead_state, runahead_state_size))
+      return piccolo->get_video_data();
+
+   // the shadow picks up from the real frame, the main instance never goes back in time so its audio stays clean
+   if (shadow)
+   {
+      if (!shadow->core_unserialize(runahead_state, runahead_state_size))
+         return piccolo->get_video_data();
+      for (unsigned i = 0; i < frames; i++)
+         shadow->core_run();
+      return shadow->get_video_data();
+   }
+
+   audio_muted = true;
+   for (unsigned i = 0; i < frames; i++)
+      piccolo->core_run();
+   audio_muted = false;
+
+   // keep the last speculative frame before the state goes back, duped frames keep showing the previous copy
+   core_frame_buffer_t* frame = piccolo->get_video_data();
+   if (frame->data)
+   {
+      size_t size = (size_t)frame->pitch * frame->height;
+      if (size > runahead_frame_capacity)
+      {
+         void* data = realloc((void*)runahead_frame.data, size);
+         if (!data)
+         {
+            logger(LOG_ERROR, tag, "failed to allocate %u bytes for frame\n", (unsigned)size);
+            piccolo->core_unserialize(runahead_state, runahead_state_size);
+            return frame;
+         }
+         runahead_frame.data = data;
+         runahead_frame_capacity = size;
+      }
+      memcpy((void*)runahead_frame.data, frame->data, size);
+      runahead_frame.width = frame->width;
+      runahead_frame.height = frame->height;
+      runahead_frame.pitch = frame->pitch;
+   }
+
+   piccolo->core_unserialize(runahead_state, runahead_state_size);
+   return &runahead_frame;
+}
+
+bool Kami::StartShadow()
+{
+   // the main instance has the library open, so this one is loaded from a private copy
+   shadow = PiccoloPool::get()->acquire();
+   shadow->set_callbacks(InputPoll, this);
+   shadow->set_frontend_supports_bitmasks(frontend_supports_bitmasks);
+   if (!shadow->load_game(core_info->file_name, piccolo->get_game_file_name(), false))
+   {
+      StopShadow();
+      return false;
+   }
+
+   // same options and devices as the main instance
+   core_option_t* options = piccolo->get_options();
+   for (size_t i = 0; i < piccolo->get_option_count(); i++)
+   {
+      core_option_t* shadow_option = shadow->find_option(options[i].key);
+      if (shadow_option)
+         shadow->set_option_value(shadow_option - shadow->get_options(), options[i].value);
    }
-   else
-      ret = false;
-   free(core_list);
 
-   return ret;
+   for (unsigned i = 0; i < piccolo->get_controller_port_count(); i++)
+      shadow->set_controller_port_device(i, piccolo->get_controller_port_device(i));
+
+   logger(LOG_INFO, tag, "run-ahead second instance loaded\n");
+   return true;
 }
 
-void Kami::OptionUpdate(core_option_t* option, const char* value)
+void Kami::StopShadow()
 {
-   logger(LOG_INFO, tag, "changing option %s to %s\n", option->description, value);
-   strlcpy(option->value, value, sizeof(option->value));
-   piccolo->set_options_updated();
+   if (!shadow)
+      return;
+
+   PiccoloPool::get()->release(shadow);
+   shadow = NULL;
+}
+
+bool Kami::RewindUpdate()
+{
+   if (!rewind_enabled.load(std::memory_order_acquire))
+   {
+      if (rewind.IsReady())
+         rewind.Deinit();
+      return false;
+   }
+
+   size_t state_size = piccolo->core_serialize_size();
+   size_t capacity = rewind_capacity.load(std::memory_order_relaxed);
+
+   // cores without savestate support can't rewind
+   if (state_size == 0)
+      return false;
+
+   if (rewind.IsReady() && rewind.GetStateSize() == state_size && rewind.GetCapacity() == capacity)
+      return true;
+
+   void* state = realloc(rewind_state, state_size);
+   if (!state)
+   {
+      logger(LOG_ERROR, tag, "failed to allocate %u bytes for savestates\n", (unsigned)state_size);
+      rewind.Deinit();
+      return false;
+   }
+   rewind_state = state;
+   rewind_state_size = state_size;
+   rewind_counter = 0;
+
+   return rewind.Init(state_size, capacity);
 }
 
-struct string_list* Kami::OptionGetValues(core_option_t* option)
+void Kami::WorkerMain()
 {
-   return string_split(option->values, "|");
+   logger(LOG_DEBUG, tag, "worker started for %s\n", core_info->core_name);
+   pacer.Reset();
+   while (worker_running.load(std::memory_order_acquire))
+   {
+      double fps = core_info->av_info.timing.fps > 0 ? core_info->av_info.timing.fps : 60.0;
+
+      {
+         std::lock_guard<std::mutex> lock(core_lock);
+         mailbox.Publish(RunFrame());
+      }
+
+      // the worker is not tied to the display, it follows the core's own refresh rate
+      pacer.SetRate(frame_limiter.load(std::memory_order_relaxed) ? fps : 0);
+      pacer.Wait();
+   }
+   logger(LOG_DEBUG, tag, "worker stopped for %s\n", core_info->core_name);
 }
 
-unsigned Kami::OptionGetIndex(core_option_t* option, struct string_list* values)
+unsigned Kami::FramesDue(double loop_rate)
 {
-   unsigned index = 0;
-   for (unsigned i = 0; i < values->size; i++)
+   double fps = core_info->av_info.timing.fps > 0 ? core_info->av_info.timing.fps : 60.0;
+
+   // an unpaced loop, or a core close enough to the loop rate for rate control to absorb the difference, runs one
+   // frame per iteration. Anything else, like a 50Hz core on a 60Hz display, accumulates the ratio of both rates
+   if (loop_rate <= 0 || fabs(fps - loop_rate) <= loop_rate * RATE_CONTROL_MAX_DEVIATION)
    {
-      if ((string_is_equal(values->elems[i].data, option->value)))
-         index = i;
+      frame_accumulator = 0;
+      return 1;
    }
-   return index;
+
+   frame_accumulator += fps / loop_rate;
+   unsigned frames = (unsigned)frame_accumulator;
+   frame_accumulator -= frames;
+
+   return MIN(frames, (unsigned)KAMI_MAX_FRAMES_PER_LOOP);
+}
+
+void Kami::StartWorker()
+{
+   if (worker.joinable())
+      return;
+
+   worker_running.store(true, std::memory_order_release);
+   worker = std::thread(&Kami::WorkerMain, this);
+}
+
+void Kami::StopWorker()
+{
+   if (!worker.joinable())
+      return;
+
+   worker_running.store(false, std::memory_order_release);
+   worker.join();
+}
+
+std::unique_lock<std::mutex> Kami::LockCore()
+{
+   std::unique_lock<std::mutex> lock(core_lock, std::defer_lock);
+   if (worker.joinable())
+      lock.lock();
+   return lock;
 }
 
 void Kami::ParseInputDescriptors()
 {
+   std::lock_guard<std::mutex> lock(core_lock);
    input_descriptor_t* new_descriptors = piccolo->get_input_descriptors();
    unsigned port = 0;
    unsigned id = 0;
@@ -98,16 +642,75 @@ void Kami::ParseInputDescriptors()
       id = new_descriptors[i].id;
       idx = new_descriptors[i].index;
       desc = new_descriptors[i].description;
+      if (port >= MAX_PORTS || id >= MAX_IDS)
+         continue;
 
+      strlcpy(input_descriptions[port][id], desc ? desc : "", sizeof(input_descriptions[port][id]));
       input_descriptors[port][id].port = port;
       input_descriptors[port][id].id = id;
       input_descriptors[port][id].index = idx;
-      input_descriptors[port][id].description = desc;
+      input_descriptors[port][id].description = input_descriptions[port][id];
    }
 }
 
-size_t kami_render_audio(const int16_t* data, size_t frames)
+bool Kami::ResamplerUpdate()
 {
-   // SDL_QueueAudio(device, data, 4 * frames);
+   double input_rate = core_info->av_info.timing.sample_rate;
+   double output_rate = get_audio_device_rate();
+   unsigned quality = resampler_quality.load(std::memory_order_relaxed);
+
+   // no device rate yet, or a core that doesn't report its rate, there is nothing sensible to convert to
+   if (input_rate <= 0 || output_rate <= 0)
+      return false;
+
+   if (
+      resampler.IsReady() && resampler.GetQuality() == quality && resampler.GetInputRate() == input_rate
+      && resampler.GetOutputRate() == output_rate)
+      return true;
+
+   if (!resampler.Init(quality, input_rate, output_rate))
+      return false;
+   rate_control.Init(get_audio_device_samples() * KAMI_AUDIO_TARGET_BLOCKS);
+
+   size_t frames = resampler.GetMaxOutput(RESAMPLER_CHUNK_FRAMES);
+   if (frames > resampler_buffer_frames)
+   {
+      int16_t* buffer = (int16_t*)realloc(resampler_buffer, frames * 2 * sizeof(int16_t));
+      if (!buffer)
+      {
+         logger(LOG_ERROR, tag, "failed to allocate resampler buffer\n");
+         resampler.Deinit();
+         return false;
+      }
+      resampler_buffer = buffer;
+      resampler_buffer_frames = frames;
+   }
+   return true;
+}
+
+size_t Kami::RenderAudio(const int16_t* data, size_t frames)
+{
+   if (audio_muted)
+      return frames;
+
+   if (!ResamplerUpdate())
+   {
+      audio_ring->Write(data, frames);
+      return frames;
+   }
+
+   for (size_t done = 0; done < frames;)
+   {
+      size_t chunk = MIN(frames - done, (size_t)RESAMPLER_CHUNK_FRAMES);
+      size_t written = resampler.Process(data + done * 2, chunk, resampler_buffer);
+
+      audio_ring->Write(resampler_buffer, written);
+      done += chunk;
+   }
    return frames;
 }
+
+size_t kami_render_audio(const int16_t* data, size_t frames, void* user)
+{
+   return ((Kami*)user)->RenderAudio(data, frames);
+}
@@ -2,11 +2,22 @@
 #define KAMI_H_
 
 // system
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include "asset.h"
 #include "common.h"
+#include "core_catalog.h"
+#include "frame_mailbox.h"
+#include "frame_pacer.h"
+#include "input_thread.h"
 #include "libretro/piccolo.h"
+#include "rate_control.h"
+#include "resampler.h"
+#include "rewind.h"
 
 enum device_gamepad_enum
 {
@@ -36,6 +47,15 @@ enum device_gamepad_enum
 
 extern const char* device_gamepad_asset_names[];
 
+// audio ring size per instance, in stereo frames
+#define KAMI_AUDIO_RING_FRAMES 8192
+// fill level rate control aims for, in device callback blocks
+#define KAMI_AUDIO_TARGET_BLOCKS 2
+// most core frames run in a single iteration of the main loop, the rest of a stall is dropped
+#define KAMI_MAX_FRAMES_PER_LOOP 4
+// share of a frame's time budget uncapped fast-forward spends on skipped frames
+#define KAMI_FASTFORWARD_BUDGET 0.75
+
 // kami class controls a core completely, provides the complete I/O for the core including file I/O, video, audio,
 // input. Implementation is GUI toolkit / paradygm specific, only common code is defined in kami.cpp
 class Kami
@@ -48,9 +68,9 @@ private:
    int previous_core;
    int core_count;
    unsigned status;
-   const char* core_entries[100];
+   // cores to choose from, shared with every other instance
+   std::shared_ptr<const CoreCatalog> catalog;
    core_info_t* core_info;
-   core_info_t core_info_list[100];
 
    // frontend related variables
    bool frontend_supports_bitmasks;
@@ -60,12 +80,170 @@ private:
    char content_file_name[PATH_MAX_LENGTH];
    input_state_t input_state[MAX_PORTS];
    input_descriptor_t input_descriptors[MAX_PORTS][MAX_IDS];
+   // the descriptions are copied, the core frees its own whenever it sets new descriptors
+   char input_descriptions[MAX_PORTS][MAX_IDS][64];
    core_frame_buffer_t* video_data;
 
    unsigned texture_data;
 
+   // background job peeking or loading a core, the gui and every other instance keep running meanwhile. The job
+   // works on an instance of its own that replaces the current one once it finished
+   std::thread job;
+   std::atomic<bool> job_done;
+   bool job_running;
+   bool job_peek;
+   // swaps run on the current instance with the worker stopped instead of on one of their own
+   bool job_swap;
+   double job_swap_time;
+   bool job_result;
+   PiccoloWrapper* job_piccolo;
+   char job_core_file[PATH_MAX_LENGTH];
+   char job_game_file[PATH_MAX_LENGTH];
+   // peeks at a core the catalog knows are answered from it without opening the library
+   core_info_t job_info;
+   bool job_info_valid;
+
+   // start peeking a core, or loading it with game_file or without content if NULL
+   void JobStart(const char* core_file, const char* game_file, bool peek);
+   // job thread entry point
+   void JobMain();
+   // swap in the result of a finished job, returns true while a job is still in progress
+   bool JobUpdate();
+   // drop what belongs to the core or content that ran until now, with core_lock held and the worker stopped
+   void ContentReset();
+
+   // threaded execution related variables
+   bool threaded;
+   std::thread worker;
+   std::atomic<bool> worker_running;
+   // serializes calls into the core between the worker and the gui thread
+   std::mutex core_lock;
+   // guards input_state, written by the gui thread and read by whichever thread runs the core
+   std::mutex input_lock;
+   // latest published physical input shared by every instance, merged with the on-screen input at the time the poll
+   // mode asks for. Called from whichever thread runs the core
+   static input_source_t input_source;
+   std::atomic<unsigned> input_poll_mode;
+   // physical input read by the gui thread every main loop iteration for early polling, guarded by input_lock
+   input_state_t input_early[MAX_PORTS];
+   // on-screen input latched when the frame started, only touched by the thread running the core
+   input_state_t input_frame[MAX_PORTS];
+   // with the input thread on, physical input arrives through the queue instead of the source. The latest state of
+   // every port is kept by the thread running the core
+   InputQueue input_queue;
+   std::atomic<bool> input_threaded;
+   input_state_t input_physical[MAX_PORTS];
+   // time from an input change being sampled to the core reading it, in milliseconds
+   std::atomic<double> input_age;
+   std::atomic<double> input_age_max;
+
+   // fill state for every port with the latched on-screen input and the physical input on top, taken from latched
+   // when it is set and read from the source otherwise
+   void InputMerge(input_state_t* state, const input_state_t* latched);
+   // read the physical input for early polling
+   void InputLatch();
+   // apply the queued input changes, measuring their age when the core is about to read them
+   void InputDrain(bool measure);
+   // keep the queue from filling up while no frame runs, the gui thread only drains it when nothing else does
+   void InputIdle()
+   {
+      if (input_threaded.load(std::memory_order_relaxed) && !worker.joinable() && !job_running)
+         InputDrain(false);
+   }
+   // the device only mixes the ring while the instance runs frames, a ring nothing writes to would count an underrun
+   // on every device callback
+   void AudioUpdate(bool producing);
+   FrameMailbox mailbox;
+   // paces the worker to the core's refresh rate while the frame limiter is on
+   FramePacer pacer;
+   std::atomic<bool> frame_limiter;
+   // fractional core frames owed when the core runs inside the main loop at a different rate
+   double frame_accumulator;
+
+   // audio related variables, the ring is written by the core thread and drained by the audio device
+   AudioRing* audio_ring;
+   bool audio_registered;
+   // the resampler and its output scratch buffer are only touched by the thread running the core, quality changes
+   // requested from the gui are picked up on the next audio batch
+   Resampler resampler;
+   int16_t* resampler_buffer;
+   size_t resampler_buffer_frames;
+   std::atomic<unsigned> resampler_quality;
+   // adjusts the resampling ratio once per frame to keep the ring at its target fill level
+   RateControl rate_control;
+   std::atomic<bool> rate_control_enabled;
+
+   // set while a frame runs whose audio must not be heard
+   bool audio_muted;
+
+   // (re)initialize the resampler when the quality or either rate changed, returns false if audio should pass through
+   bool ResamplerUpdate();
+
+   // rewind related variables, the history and the serialization buffer are only touched by the thread running the
+   // core, the configuration is requested from the gui and applied on the next frame
+   RewindBuffer rewind;
+   void* rewind_state;
+   size_t rewind_state_size;
+   unsigned rewind_counter;
+   std::atomic<bool> rewind_enabled;
+   std::atomic<unsigned> rewind_capacity;
+   std::atomic<unsigned> rewind_granularity;
+   std::atomic<bool> rewinding;
+
+   // (re)initialize the history when rewind was toggled or resized, returns false if rewind is not available
+   bool RewindUpdate();
+
+   // run-ahead related variables, only touched by the thread running the core except for the requested configuration
+   std::atomic<unsigned> runahead_frames;
+   std::atomic<bool> runahead_second_instance;
+   void* runahead_state;
+   size_t runahead_state_size;
+   // copy of the frame to show, the core's own buffer may be clobbered when the state is restored
+   core_frame_buffer_t runahead_frame;
+   size_t runahead_frame_capacity;
+   // second instance running the speculative frames, it gets its own copy of the core library like any other
+   // instance loading a library already in use
+   Piccolo* shadow;
+   bool shadow_failed;
+
+   // fast-forward runs extra core frames ahead of every shown one, their audio is dropped and their video never
+   // uploaded. A ratio of zero runs as many as fit in the frame's time budget
+   std::atomic<bool> fastforward;
+   std::atomic<unsigned> fastforward_ratio;
+   bool fastforwarding;
+   // core frames run per shown frame, smoothed
+   std::atomic<double> fastforward_speed;
+
+   // run the skipped frames that come before the shown one, returns how many ran
+   unsigned FastForward(std::chrono::steady_clock::time_point start);
+
+   // frame timing in milliseconds, written by the thread running the core
+   std::atomic<double> frame_time;
+   std::atomic<double> frame_time_max;
+   std::atomic<double> runahead_time;
+   std::atomic<uint64_t> frames_over_budget;
+
+   // prepare run-ahead for this frame, returns the number of frames to run ahead or zero if disabled or unavailable
+   unsigned RunAheadUpdate();
+   // run the speculative frames after the real one, returns the frame to show
+   core_frame_buffer_t* RunAhead(unsigned frames);
+   bool StartShadow();
+   void StopShadow();
+
+   // run a single core frame with the latest input, returns the frame to show
+   core_frame_buffer_t* RunFrame();
+   // worker thread entry point
+   void WorkerMain();
+   // core frames to run in this iteration of a main loop running at loop_rate, zero for an unpaced loop
+   unsigned FramesDue(double loop_rate);
+   void StartWorker();
+   void StopWorker();
+   // core_lock while the worker is running, it may replace what the core owns in the middle of a frame
+   std::unique_lock<std::mutex> LockCore();
+
 public:
    Kami()
+      : input_queue(INPUT_QUEUE_SIZE)
    {
       status = CORE_STATUS_NONE;
       current_core = 0;
@@ -73,35 +251,164 @@ public:
       core_count = 0;
       core_loaded = false;
       this->piccolo = new PiccoloWrapper();
-      core_info = piccolo->get_info();
+      core_info = NULL;
+
+      job_done = false;
+      job_running = false;
+      job_peek = false;
+      job_swap = false;
+      job_swap_time = 0;
+      job_result = false;
+      job_piccolo = NULL;
+      job_core_file[0] = '\0';
+      job_game_file[0] = '\0';
 
       texture_data = 0;
+      threaded = false;
+      worker_running = false;
+      input_poll_mode = INPUT_POLL_LATE;
+      memset(input_early, 0, sizeof(input_early));
+      memset(input_frame, 0, sizeof(input_frame));
+      input_threaded = false;
+      memset(input_physical, 0, sizeof(input_physical));
+      memset(input_descriptors, 0, sizeof(input_descriptors));
+      memset(input_descriptions, 0, sizeof(input_descriptions));
+      input_age = 0;
+      input_age_max = 0;
+      frame_limiter = true;
+      frame_accumulator = 0;
+
+      audio_ring = new AudioRing(KAMI_AUDIO_RING_FRAMES);
+      audio_registered = false;
+      resampler_buffer = NULL;
+      resampler_buffer_frames = 0;
+      resampler_quality = RESAMPLER_QUALITY_SINC;
+      rate_control_enabled = true;
+      audio_muted = false;
+
+      rewind_state = NULL;
+      rewind_state_size = 0;
+      rewind_counter = 0;
+      rewind_enabled = false;
+      rewind_capacity = 0;
+      rewind_granularity = 1;
+      rewinding = false;
+
+      runahead_frames = 0;
+      runahead_second_instance = false;
+      runahead_state = NULL;
+      runahead_state_size = 0;
+      memset(&runahead_frame, 0, sizeof(runahead_frame));
+      runahead_frame_capacity = 0;
+      shadow = NULL;
+      shadow_failed = false;
+
+      fastforward = false;
+      fastforward_ratio = 0;
+      fastforwarding = false;
+      fastforward_speed = 1.0;
+
+      frame_time = 0;
+      frame_time_max = 0;
+      runahead_time = 0;
+      frames_over_budget = 0;
    }
 
-   ~Kami() { delete piccolo; }
+   ~Kami()
+   {
+      if (job.joinable())
+         job.join();
+      if (!job_swap)
+         delete job_piccolo;
+      StopWorker();
+      StopShadow();
+      if (audio_registered)
+         audio_unregister_source(audio_ring);
+      delete piccolo;
+      delete audio_ring;
+      free(resampler_buffer);
+      free(rewind_state);
+      free(runahead_state);
+      free((void*)runahead_frame.data);
+   }
 
    // common functions
    bool CoreListInit(const char* path);
-   struct string_list* OptionGetValues(core_option_t* option);
-   unsigned OptionGetIndex(core_option_t* option, struct string_list* values);
-   void OptionUpdate(core_option_t* option, const char* value);
-   void ControllerPortUpdate(int port, int device) { piccolo->set_controller_port_device(port, device); }
+   void OptionUpdate(unsigned index, unsigned value);
+   void ControllerPortUpdate(int port, int device);
    void ParseInputDescriptors();
    input_state_t GetInputState(int port) { return input_state[port]; }
+   void SetInputState(int port, input_state_t state);
+   // load other content on the running core without reloading the core itself, in the background like a core load
+   void SwapContent(const char* game_file);
+   void Reset();
 
    core_info_t* GetCoreInfo() { return core_info; }
    unsigned GetCoreStatus() { return status; }
    unsigned GetTextureData() { return texture_data; }
 
-   void Main();
+   // when physical input is read, one of input_poll_modes_enum
+   void SetInputPollMode(unsigned mode) { input_poll_mode.store(mode, std::memory_order_relaxed); }
+   static void SetInputSource(input_source_t source) { input_source = source; }
+   // take physical input from the queue an input thread feeds instead of sampling the source
+   void SetInputThreaded(bool value)
+   {
+      input_threaded.store(value, std::memory_order_relaxed);
+      input_age_max.store(0, std::memory_order_relaxed);
+   }
+   InputQueue* GetInputQueue() { return &input_queue; }
+   // poll callback handed to piccolo, user data is the owning kami instance
+   static void InputPoll(input_state_t* state, unsigned ports, void* user);
+
+   // run the core on a dedicated worker thread instead of inside Main
+   void SetThreaded(bool value) { threaded = value; }
+   bool GetThreaded() { return threaded; }
+
+   // pace the worker to the core's refresh rate, without it a threaded core runs as fast as it can
+   void SetFrameLimiter(bool value) { frame_limiter.store(value, std::memory_order_relaxed); }
+   const FramePacer* GetPacer() { return &pacer; }
+
+   void SetResamplerQuality(unsigned value) { resampler_quality.store(value, std::memory_order_relaxed); }
+   const Resampler* GetResampler() { return &resampler; }
+   void SetRateControl(bool value) { rate_control_enabled.store(value, std::memory_order_relaxed); }
+   const RateControl* GetRateControl() { return &rate_control; }
+
+   // capacity in bytes, a snapshot is taken every granularity frames
+   void SetRewind(bool enabled, unsigned capacity, unsigned granularity)
+   {
+      rewind_capacity.store(capacity, std::memory_order_relaxed);
+      rewind_granularity.store(granularity, std::memory_order_relaxed);
+      rewind_enabled.store(enabled, std::memory_order_release);
+   }
+   // step back through the history instead of running forward while set
+   void SetRewinding(bool value) { rewinding.store(value, std::memory_order_relaxed); }
+   const RewindBuffer* GetRewind() { return &rewind; }
+
+   // run frames speculative frames after every real one and show the last, optionally on a second instance
+   void SetRunAhead(unsigned frames, bool second_instance)
+   {
+      runahead_frames.store(frames, std::memory_order_relaxed);
+      runahead_second_instance.store(second_instance, std::memory_order_relaxed);
+      frame_time_max.store(0, std::memory_order_relaxed);
+      frames_over_budget.store(0, std::memory_order_relaxed);
+   }
+
+   // core frames run per shown frame while fast-forwarding, zero runs as many as the frame time allows
+   void SetFastForwardRatio(unsigned ratio) { fastforward_ratio.store(ratio, std::memory_order_relaxed); }
+   void SetFastForward(bool value) { fastforward.store(value, std::memory_order_relaxed); }
+   bool GetFastForward() { return fastforward.load(std::memory_order_relaxed); }
+
+   // run the core for one iteration of the main loop, loop_rate is the rate the loop runs at or zero if unpaced
+   void Main(double loop_rate);
 
    // implementation specific functions
    void RenderGui(const char* title);
+   void RenderJobProgress();
    unsigned RenderVideo(unsigned* output);
-   static void InputPoll();
+   size_t RenderAudio(const int16_t* data, size_t frames);
 };
 
-// TODO: reimplement these
-size_t kami_render_audio(const int16_t* data, size_t frames);
+// audio callback handed to piccolo, user data is the owning kami instance
+size_t kami_render_audio(const int16_t* data, size_t frames, void* user);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,206 @@
+// system
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "frame_pacer.h"
+#include "libretro/piccolo.h"
+#include "util.h"
+
+static const char* tag = "[benchmark]";
+
+#define BENCHMARK_DEFAULT_FRAMES 3000
+#define BENCHMARK_DEFAULT_WARMUP 60
+#define BENCHMARK_HISTOGRAM_BUCKETS 24
+
+typedef std::chrono::steady_clock benchmark_clock;
+
+// input is not fed in headless mode, the core always sees an idle pad
+static void benchmark_input_poll(input_state_t* state, unsigned ports, void* user)
+{ }
+
+// audio is counted and discarded
+static size_t benchmark_audio(const int16_t* data, size_t frames, void* user)
+{
+   *(uint64_t*)user += frames;
+   return frames;
+}
+
+static void print_usage(const char* name)
+{
+   fprintf(
+      stderr,
+      "usage: %s [-f frames] [-w warmup frames] [-p] <core> [content]\n"
+      "  -f  number of measured frames (default %d)\n"
+      "  -w  number of frames to run before measuring (default %d)\n"
+      "  -p  pace frames to the core refresh rate and report the pacing accuracy\n",
+      name, BENCHMARK_DEFAULT_FRAMES, BENCHMARK_DEFAULT_WARMUP);
+}
+
+static uint64_t percentile(const std::vector<uint64_t>& sorted, double p)
+{
+   if (sorted.empty())
+      return 0;
+
+   size_t index = (size_t)(p * (sorted.size() - 1) + 0.5);
+   return sorted[std::min(index, sorted.size() - 1)];
+}
+
+// prints a json string, core names and paths may contain quotes or windows path separators
+static void print_string(const char* str)
+{
+   putchar('"');
+   for (; *str; str++)
+   {
+      if (*str == '"' || *str == '\\')
+         putchar('\\');
+      if ((unsigned char)*str >= 0x20)
+         putchar(*str);
+   }
+   putchar('"');
+}
+
+int main(int argc, char* argv[])
+{
+   const char* core_file_name = NULL;
+   const char* game_file_name = NULL;
+   unsigned frames = BENCHMARK_DEFAULT_FRAMES;
+   unsigned warmup = BENCHMARK_DEFAULT_WARMUP;
+   bool paced = false;
+
+   logger_set_level(LOG_WARN);
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (string_is_equal(argv[i], "-f") && i + 1 < argc)
+         frames = strtoul(argv[++i], NULL, 10);
+      else if (string_is_equal(argv[i], "-w") && i + 1 < argc)
+         warmup = strtoul(argv[++i], NULL, 10);
+      else if (string_is_equal(argv[i], "-p"))
+         paced = true;
+      else if (!core_file_name)
+         core_file_name = argv[i];
+      else if (!game_file_name)
+         game_file_name = argv[i];
+      else
+      {
+         print_usage(argv[0]);
+         return 1;
+      }
+   }
+
+   if (!core_file_name || frames == 0)
+   {
+      print_usage(argv[0]);
+      return 1;
+   }
+
+   Piccolo* piccolo = new Piccolo();
+   input_state_t idle = {};
+   uint64_t audio_frames = 0;
+
+   piccolo->set_callbacks(benchmark_input_poll, NULL);
+   piccolo->set_frontend_supports_bitmasks(true);
+   for (unsigned i = 0; i < MAX_PORTS; i++)
+      piccolo->set_input_state(i, idle);
+
+   benchmark_clock::time_point load_start = benchmark_clock::now();
+   if (!piccolo->load_game(core_file_name, game_file_name, false))
+   {
+      logger(LOG_ERROR, tag, "failed to load %s\n", game_file_name ? game_file_name : core_file_name);
+      delete piccolo;
+      return 1;
+   }
+   double load_ms = std::chrono::duration<double, std::milli>(benchmark_clock::now() - load_start).count();
+
+   for (unsigned i = 0; i < warmup; i++)
+      piccolo->core_run();
+   piccolo->set_audio_callback(benchmark_audio, &audio_frames);
+
+   // samples are preallocated so the measurement loop does nothing but run the core and read the clock
+   std::vector<uint64_t> samples(frames);
+   core_info_t* info = piccolo->get_info();
+   FramePacer pacer;
+
+   if (paced)
+      pacer.SetRate(info->av_info.timing.fps > 0 ? info->av_info.timing.fps : 60.0);
+
+   benchmark_clock::time_point run_start = benchmark_clock::now();
+   for (unsigned i = 0; i < frames; i++)
+   {
+      benchmark_clock::time_point start = benchmark_clock::now();
+      piccolo->core_run();
+      samples[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(benchmark_clock::now() - start).count();
+      if (paced)
+         pacer.Wait();
+   }
+   double run_s = std::chrono::duration<double>(benchmark_clock::now() - run_start).count();
+
+   // power of two buckets in microseconds, the last bucket collects everything above
+   unsigned histogram[BENCHMARK_HISTOGRAM_BUCKETS] = {0};
+   uint64_t total = 0;
+   for (uint64_t sample : samples)
+   {
+      unsigned bucket = 0;
+      uint64_t us = sample / 1000;
+
+      while (us >= (1ull << bucket) && bucket < BENCHMARK_HISTOGRAM_BUCKETS - 1)
+         bucket++;
+      histogram[bucket]++;
+      total += sample;
+   }
+
+   std::sort(samples.begin(), samples.end());
+
+   printf("{\n");
+   printf("   \"core\": ");
+   print_string(info->core_name);
+   printf(",\n   \"core_version\": ");
+   print_string(info->core_version);
+   printf(",\n   \"content\": ");
+   print_string(game_file_name ? game_file_name : "");
+   printf(",\n");
+   printf("   \"load_ms\": %.3f,\n", load_ms);
+   printf("   \"warmup_frames\": %u,\n", warmup);
+   printf("   \"frames\": %u,\n", frames);
+   printf("   \"seconds\": %.6f,\n", run_s);
+   printf("   \"fps\": %.3f,\n", frames / run_s);
+   printf("   \"core_fps\": %.3f,\n", info->av_info.timing.fps);
+   printf("   \"audio_frames_per_frame\": %.3f,\n", (double)audio_frames / frames);
+   printf("   \"retro_run_ns\": {\n");
+   printf("      \"min\": %llu,\n", (unsigned long long)samples.front());
+   printf("      \"mean\": %llu,\n", (unsigned long long)(total / frames));
+   printf("      \"p50\": %llu,\n", (unsigned long long)percentile(samples, 0.50));
+   printf("      \"p90\": %llu,\n", (unsigned long long)percentile(samples, 0.90));
+   printf("      \"p99\": %llu,\n", (unsigned long long)percentile(samples, 0.99));
+   printf("      \"max\": %llu\n", (unsigned long long)samples.back());
+   printf("   },\n");
+   printf("   \"histogram_us\": [");
+
+   bool first = true;
+   for (unsigned i = 0; i < BENCHMARK_HISTOGRAM_BUCKETS; i++)
+   {
+      if (!histogram[i])
+         continue;
+      if (i == BENCHMARK_HISTOGRAM_BUCKETS - 1)
+         printf("%s\n      {\"lt\": null, \"count\": %u}", first ? "" : ",", histogram[i]);
+      else
+         printf("%s\n      {\"lt\": %llu, \"count\": %u}", first ? "" : ",", 1ull << i, histogram[i]);
+      first = false;
+   }
+   printf("\n   ]");
+   if (paced)
+   {
+      printf(",\n   \"pacing\": {\n");
+      printf("      \"rate\": %.3f,\n", pacer.GetRate());
+      printf("      \"jitter_us\": %.3f,\n", pacer.GetJitter());
+      printf("      \"jitter_max_us\": %.3f,\n", pacer.GetJitterMax());
+      printf("      \"late\": %llu\n", (unsigned long long)pacer.GetLate());
+      printf("   }");
+   }
+   printf("\n}\n");
+
+   piccolo->unload_core();
+   delete piccolo;
+   return 0;
+}
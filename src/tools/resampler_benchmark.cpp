@@ -0,0 +1,155 @@
+// system
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "resampler.h"
+#include "util.h"
+
+#define RESAMPLER_BENCHMARK_DEFAULT_FRAMES (1 << 20)
+#define RESAMPLER_BENCHMARK_DEFAULT_INPUT_RATE 32040.5
+#define RESAMPLER_BENCHMARK_DEFAULT_OUTPUT_RATE 48000.0
+#define RESAMPLER_BENCHMARK_DEFAULT_PASSES 5
+// input is fed in batches of roughly one frame worth of audio, like a core would
+#define RESAMPLER_BENCHMARK_BATCH_FRAMES 800
+
+typedef std::chrono::steady_clock benchmark_clock;
+
+static const char* quality_names[] = {"linear", "sinc"};
+
+static void print_usage(const char* name)
+{
+   fprintf(
+      stderr,
+      "usage: %s [-f frames] [-i input rate] [-o output rate] [-p passes]\n"
+      "  -f  number of input frames per pass (default %d)\n"
+      "  -i  input rate in Hz (default %.1f)\n"
+      "  -o  output rate in Hz (default %.1f)\n"
+      "  -p  number of passes, the fastest one is reported (default %d)\n",
+      name, RESAMPLER_BENCHMARK_DEFAULT_FRAMES, RESAMPLER_BENCHMARK_DEFAULT_INPUT_RATE,
+      RESAMPLER_BENCHMARK_DEFAULT_OUTPUT_RATE, RESAMPLER_BENCHMARK_DEFAULT_PASSES);
+}
+
+// runs a full pass over the input, returns the elapsed time and fills out with the resampled audio
+static double run_pass(Resampler* resampler, const std::vector<int16_t>& in, std::vector<int16_t>& out, size_t* written)
+{
+   size_t frames = in.size() / 2;
+   size_t total = 0;
+
+   benchmark_clock::time_point start = benchmark_clock::now();
+   for (size_t done = 0; done < frames;)
+   {
+      size_t batch = std::min(frames - done, (size_t)RESAMPLER_BENCHMARK_BATCH_FRAMES);
+      total += resampler->Process(&in[done * 2], batch, &out[total * 2]);
+      done += batch;
+   }
+   double seconds = std::chrono::duration<double>(benchmark_clock::now() - start).count();
+
+   *written = total;
+   return seconds;
+}
+
+int main(int argc, char* argv[])
+{
+   unsigned frames = RESAMPLER_BENCHMARK_DEFAULT_FRAMES;
+   double input_rate = RESAMPLER_BENCHMARK_DEFAULT_INPUT_RATE;
+   double output_rate = RESAMPLER_BENCHMARK_DEFAULT_OUTPUT_RATE;
+   unsigned passes = RESAMPLER_BENCHMARK_DEFAULT_PASSES;
+
+   logger_set_level(LOG_WARN);
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (string_is_equal(argv[i], "-f") && i + 1 < argc)
+         frames = strtoul(argv[++i], NULL, 10);
+      else if (string_is_equal(argv[i], "-i") && i + 1 < argc)
+         input_rate = strtod(argv[++i], NULL);
+      else if (string_is_equal(argv[i], "-o") && i + 1 < argc)
+         output_rate = strtod(argv[++i], NULL);
+      else if (string_is_equal(argv[i], "-p") && i + 1 < argc)
+         passes = strtoul(argv[++i], NULL, 10);
+      else
+      {
+         print_usage(argv[0]);
+         return 1;
+      }
+   }
+
+   if (frames == 0 || passes == 0 || input_rate <= 0 || output_rate <= 0)
+   {
+      print_usage(argv[0]);
+      return 1;
+   }
+
+   // a pair of tones with some noise on top, different per channel so swapped channels show up as errors
+   std::vector<int16_t> in(frames * 2);
+   srand(1);
+   for (unsigned i = 0; i < frames; i++)
+   {
+      double t = i / input_rate;
+      in[i * 2] = (int16_t)(12000 * sin(2 * M_PI * 440 * t) + (rand() % 512 - 256));
+      in[i * 2 + 1] = (int16_t)(12000 * sin(2 * M_PI * 3000 * t) + (rand() % 512 - 256));
+   }
+
+   printf("{\n");
+   printf("   \"input_rate\": %.3f,\n", input_rate);
+   printf("   \"output_rate\": %.3f,\n", output_rate);
+   printf("   \"frames\": %u,\n", frames);
+   printf("   \"passes\": %u,\n", passes);
+   printf("   \"results\": [");
+
+   bool first = true;
+   for (unsigned quality = 0; quality < RESAMPLER_QUALITY_LAST; quality++)
+   {
+      // the scalar kernel is the reference every other kernel is compared against
+      std::vector<int16_t> reference;
+      size_t reference_frames = 0;
+
+      for (unsigned simd = RESAMPLER_SIMD_SCALAR; simd < RESAMPLER_SIMD_LAST; simd++)
+      {
+         if (!Resampler::IsSupported(simd))
+            continue;
+
+         Resampler resampler;
+         if (!resampler.Init(quality, input_rate, output_rate, simd))
+            return 1;
+
+         std::vector<int16_t> out(resampler.GetMaxOutput(frames) * 2);
+         size_t written = 0;
+         double best = 0;
+
+         for (unsigned pass = 0; pass < passes; pass++)
+         {
+            resampler.Init(quality, input_rate, output_rate, simd);
+            double seconds = run_pass(&resampler, in, out, &written);
+            if (pass == 0 || seconds < best)
+               best = seconds;
+         }
+
+         if (simd == RESAMPLER_SIMD_SCALAR)
+         {
+            reference = out;
+            reference_frames = written;
+         }
+
+         int max_error = 0;
+         for (size_t i = 0; i < std::min(written, reference_frames) * 2; i++)
+            max_error = std::max(max_error, abs(out[i] - reference[i]));
+
+         printf("%s\n      {", first ? "" : ",");
+         printf("\"quality\": \"%s\", ", quality_names[quality]);
+         printf("\"kernel\": \"%s\", ", Resampler::GetSimdName(simd));
+         printf("\"output_frames\": %llu, ", (unsigned long long)written);
+         printf("\"ns_per_frame\": %.3f, ", best * 1e9 / written);
+         printf("\"realtime_factor\": %.1f, ", (written / output_rate) / best);
+         printf("\"max_error\": %d}", written == reference_frames ? max_error : -1);
+         first = false;
+      }
+   }
+   printf("\n   ]\n");
+   printf("}\n");
+
+   return 0;
+}